@@ -0,0 +1,541 @@
+/* Performance regression check for uppaal2octopus.
+ *
+ * Generates a fixed set of traces, converts them with the given binary
+ * and compares the throughput and peak memory of every case to a recorded
+ * baseline. The output of every case must be identical to the recorded
+ * golden output, of which only a checksum is kept.
+ *
+ * Throughput is recorded relative to a calibration loop timed alongside
+ * every case, as events per second of calibration, so that a baseline
+ * recorded on one machine holds on another one.
+ *
+ * The hr parser is also run in-process, counting the calls to operator
+ * new: once warmed up, parsing a state must not allocate at all.
+ *
+ * Usage: perf_check [--record] [--tolerance x] <uppaal2octopus> <perf dir> <work dir>
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <new>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../src/hrparser.hpp"
+
+// Counted while parsing the hr trace in-process
+static size_t allocations = 0;
+
+void* operator new(size_t size)
+{
+	allocations++;
+	
+	void* p = malloc(size == 0 ? 1 : size);
+	if(p == nullptr)
+		throw std::bad_alloc();
+	
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+namespace uppaal2octopus
+{
+	namespace perf
+	{
+		// Deterministic on every platform, unlike the standard distributions
+		struct rng_t
+		{
+			uint64_t s;
+			
+			uint64_t next()
+			{
+				s ^= s << 13;
+				s ^= s >> 7;
+				s ^= s << 17;
+				return s;
+			}
+			
+			size_t below(const size_t n)
+			{
+				return static_cast<size_t>((next() >> 11) % n);
+			}
+			
+			bool chance(const size_t percent)
+			{
+				return below(100) < percent;
+			}
+		};
+		
+		struct case_t
+		{
+			std::string name;
+			std::vector<std::string> args;
+		};
+		
+		struct result_t
+		{
+			double events_per_s;
+			long peak_kib;
+			uint64_t checksum;
+		};
+		
+		std::string inline location_name(const size_t k, const size_t locations)
+		{
+			return (k + 1 == locations ? "_tmp" : "loc") + std::to_string(k);
+		}
+		
+		// A model of independent processes walking over a ring of locations, as an xtr and hr trace.
+		void inline generate(const std::string& prefix, const size_t processes, const size_t locations, const size_t steps, const uint64_t seed)
+		{
+			rng_t rng = {seed};
+			const size_t variables = 4;
+			
+			std::ofstream model(prefix + ".if"), xtr(prefix + ".xtr"), hr(prefix + ".hr");
+			
+			// Model in intermediate format
+			size_t idx = 0;
+			model << "layout\n";
+			model << idx++ << ":clock:0:t(0)\n";
+			model << idx++ << ":clock:1:c\n";
+			for(size_t p = 0; p < processes; p++)
+				model << idx++ << ":clock:" << p + 2 << ":x" << p << "\n";
+			for(size_t v = 0; v < variables; v++)
+				model << idx++ << ":var:0:100:0:" << v << ":v" << v << "\n";
+			model << idx++ << ":const:5\n";
+			
+			const size_t first_location = idx;
+			for(size_t p = 0; p < processes; p++)
+				for(size_t k = 0; k < locations; k++)
+					model << idx++ << ":location:" << (k == 1 ? "committed" : "") << ":" << location_name(k, locations) << "\n";
+			
+			model << "\ninstructions\n0:1 2 3\n\nprocesses\n";
+			for(size_t p = 0; p < processes; p++)
+				model << p << ":" << first_location + p * locations << ":Proc" << p << "\n";
+			
+			model << "\nlocations\n";
+			for(size_t p = 0; p < processes; p++)
+				for(size_t k = 0; k < locations; k++)
+					model << first_location + p * locations + k << ":" << p << ":-1\n";
+			
+			// Every location has an edge to the next two locations
+			model << "\nedges\n";
+			for(size_t p = 0; p < processes; p++)
+				for(size_t k = 0; k < locations; k++)
+					for(size_t d = 1; d <= 2; d++)
+						model << p << ":" << first_location + p * locations + k << ":" << first_location + p * locations + (k + d) % locations << ":0:0:0\n";
+			
+			model << "\nexpressions\n0:1:2:x < 5 && y > 3\n\n";
+			
+			std::vector<size_t> current(processes, 0);
+			std::vector<int> values(variables, 0);
+			uint32_t clock = 0;
+			
+			// An xtr trace lists every state before the transition taken from it
+			const auto xtr_state = [&]() {
+				for(const size_t k : current)
+					xtr << k << "\n";
+				xtr << ".\n";
+				
+				xtr << "0\n1\n" << -static_cast<int64_t>(clock) * 2 + 1 << "\n.\n";
+				xtr << "1\n0\n" << static_cast<int64_t>(clock) * 2 + 1 << "\n.\n";
+				for(size_t p = 0; p < processes; p++)
+					if(rng.chance(50))
+						xtr << "0\n" << p + 2 << "\n" << -static_cast<int64_t>(rng.below(6)) * 2 + 1 << "\n.\n";
+				xtr << ".\n";
+				
+				for(const int v : values)
+					xtr << v << "\n";
+				xtr << ".\n";
+			};
+			
+			const auto hr_state = [&]() {
+				hr << "State (";
+				for(size_t p = 0; p < processes; p++)
+					hr << " Proc" << p << "." << location_name(current[p], locations);
+				hr << " ) c>=" << clock << ", c<=" << clock << ", t(0)-c<=-" << clock << ", x0-c<=0, ";
+				for(size_t v = 0; v < variables; v++)
+					hr << (v == 0 ? "" : " ") << "v" << v << "=" << values[v];
+				hr << "\n";
+			};
+			
+			xtr_state();
+			hr_state();
+			
+			const uint32_t delays[] = {0, 1, 2, 5, 10};
+			for(size_t step = 0; step < steps; step++)
+			{
+				clock += delays[rng.below(5)];
+				for(int& v : values)
+					if(rng.chance(20))
+						v = static_cast<int>(rng.below(4));
+				
+				std::vector<size_t> moving(1, rng.below(processes));
+				if(rng.chance(20))
+				{
+					const size_t q = rng.below(processes);
+					if(q != moving[0])
+						moving.push_back(q);
+				}
+				
+				xtr_state();
+				
+				hr << "Transitions:\n";
+				for(const size_t p : moving)
+				{
+					const size_t d = 1 + rng.below(2);
+					const size_t from = current[p], to = (from + d) % locations;
+					
+					xtr << p << " " << from * 2 + d << "\n";
+					hr << "  Proc" << p << "." << location_name(from, locations) << "->Proc" << p << "." << location_name(to, locations)
+						<< " { v0 < 5, tau, v1 := v1 + 1, v2 := 0 }\n";
+					
+					current[p] = to;
+				}
+				xtr << ".\n";
+				
+				hr_state();
+			}
+			
+			xtr << ".\n";
+			
+			if(!model || !xtr || !hr)
+				throw std::runtime_error("Failed to write traces to " + prefix);
+		}
+		
+		// FNV-1a over the contents of a file
+		uint64_t inline checksum(const std::string& path, size_t& lines)
+		{
+			std::ifstream is(path, std::ios::binary);
+			if(!is)
+				throw std::runtime_error("Cannot open " + path);
+			
+			uint64_t h = 14695981039346656037ull;
+			lines = 0;
+			
+			std::vector<char> buffer(1 << 16);
+			while(is.read(buffer.data(), buffer.size()) || is.gcount() > 0)
+			{
+				for(std::streamsize i = 0; i < is.gcount(); i++)
+				{
+					h = (h ^ static_cast<unsigned char>(buffer[i])) * 1099511628211ull;
+					lines += buffer[i] == '\n';
+				}
+			}
+			
+			return h;
+		}
+		
+		// Run the binary with the given arguments, returning its wall time in seconds and peak memory
+		double inline run(const std::string& binary, const std::vector<std::string>& args, long& peak_kib)
+		{
+			std::vector<char*> argv;
+			argv.push_back(const_cast<char*>(binary.c_str()));
+			for(const std::string& a : args)
+				argv.push_back(const_cast<char*>(a.c_str()));
+			argv.push_back(nullptr);
+			
+			const auto start = std::chrono::steady_clock::now();
+			
+			const pid_t pid = fork();
+			if(pid < 0)
+				throw std::runtime_error("Failed to fork");
+			
+			if(pid == 0)
+			{
+				const int null = open("/dev/null", O_WRONLY);
+				dup2(null, STDERR_FILENO);
+				execv(binary.c_str(), argv.data());
+				_exit(127);
+			}
+			
+			int status;
+			struct rusage usage;
+			if(wait4(pid, &status, 0, &usage) != pid)
+				throw std::runtime_error("Failed to wait for " + binary);
+			
+			const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			
+			// The command line tool returns 1 on success
+			if(!WIFEXITED(status) || WEXITSTATUS(status) != 1)
+				throw std::runtime_error("Conversion failed: " + binary + " " + args.back());
+			
+			peak_kib = usage.ru_maxrss;
+			return elapsed.count();
+		}
+		
+		/* Seconds taken by a fixed amount of work like that of a conversion:
+		 * scanning the text of a trace for numbers and hashing it. The text
+		 * is kept small, as the peak memory of the cases includes ours.
+		 */
+		double inline calibrate(const std::string& text)
+		{
+			static volatile uint64_t sink = 0; // Keeps the loop from being optimised away
+			
+			const auto start = std::chrono::steady_clock::now();
+			
+			uint64_t h = 14695981039346656037ull, number = 0, sum = 0;
+			for(size_t pass = 0; pass < 32; pass++)
+				for(const char c : text)
+				{
+					h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+					
+					if(c >= '0' && c <= '9')
+						number = number * 10 + static_cast<uint64_t>(c - '0');
+					else
+					{
+						sum += number;
+						number = 0;
+					}
+				}
+			
+			sink = sink + h + sum;
+			
+			const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			return elapsed.count();
+		}
+		
+		// Parse an hr trace, returning the allocations per state after the first warm_up states
+		double inline allocations_per_state(const std::string& path, const size_t warm_up)
+		{
+			std::ifstream is(path);
+			if(!is)
+				throw std::runtime_error("Cannot open " + path);
+			
+			hrparser p(is);
+			size_t events = 0;
+			const hrparser::callback_t f = [&](const location_t&, const clock_t, const startend_e) {
+				events++;
+			};
+			
+			for(size_t i = 0; i < warm_up; i++)
+				if(!p.next(f))
+					throw std::runtime_error("Trace " + path + " is shorter than the warm-up");
+			
+			const size_t before = allocations;
+			size_t states = 0;
+			while(p.next(f))
+				states++;
+			
+			return states == 0 ? 0 : static_cast<double>(allocations - before) / states;
+		}
+		
+		std::map<std::string, std::vector<std::string>> inline read_table(const std::string& path)
+		{
+			std::map<std::string, std::vector<std::string>> result;
+			std::ifstream is(path);
+			
+			std::string line;
+			while(std::getline(is, line))
+			{
+				if(line.empty() || line[0] == '#')
+					continue;
+				
+				std::istringstream fields(line);
+				std::string name, field;
+				fields >> name;
+				
+				while(fields >> field)
+					result[name].push_back(field);
+			}
+			
+			return result;
+		}
+		
+		int inline main(int argc, char** argv)
+		{
+			bool record = false;
+			double tolerance = 0.2;
+			std::vector<std::string> positional;
+			
+			for(int i = 1; i < argc; i++)
+			{
+				if(strcmp(argv[i], "--record") == 0)
+					record = true;
+				else if(strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+					tolerance = atof(argv[++i]);
+				else
+					positional.push_back(argv[i]);
+			}
+			
+			if(positional.size() != 3)
+			{
+				std::cerr << "Usage: perf_check [--record] [--tolerance x] <uppaal2octopus> <perf dir> <work dir>" << std::endl;
+				return 2;
+			}
+			
+			const std::string binary = positional[0], perf_dir = positional[1], work_dir = positional[2];
+			const std::string baseline_path = perf_dir + "/baseline", golden_path = perf_dir + "/golden";
+			const std::string trace = work_dir + "/trace";
+			
+			mkdir(work_dir.c_str(), 0777);
+			
+			std::cout << "Generating traces in " << work_dir << std::endl;
+			generate(trace, 20, 6, 100000, 0x9e3779b97f4a7c15ull);
+			
+			std::string calibration_text(1 << 20, '\0');
+			std::ifstream calibration_is(trace + ".hr", std::ios::binary);
+			if(!calibration_is.read(&calibration_text[0], static_cast<std::streamsize>(calibration_text.size())))
+				throw std::runtime_error("Cannot read " + trace + ".hr for calibration");
+			
+			const std::vector<case_t> cases = {
+				{"hr", {"hr", trace + ".hr"}},
+				{"hr-sorted", {"-s", "hr", trace + ".hr"}},
+				{"hr-csv", {"-f", "csv", "hr", trace + ".hr"}},
+				{"hr-jsonl", {"-f", "jsonl", "hr", trace + ".hr"}},
+				{"xtr", {"xtr", trace + ".xtr", trace + ".if"}},
+				{"xtr-threads", {"-j", "2", "xtr", trace + ".xtr", trace + ".if"}}
+			};
+			
+			auto baseline = read_table(baseline_path);
+			auto golden = read_table(golden_path);
+			
+			std::map<std::string, result_t> results; // With the throughput relative to the calibration
+			bool failed = false;
+			
+			for(const case_t& c : cases)
+			{
+				const std::string output = work_dir + "/" + c.name + ".txt";
+				std::vector<std::string> args = {"-o", output};
+				args.insert(args.end(), c.args.begin(), c.args.end());
+				
+				// The best of three runs, each next to a calibration run, to be less sensitive to noise
+				double best = 0, calibration = 0;
+				long peak_kib = 0;
+				for(size_t i = 0; i < 3; i++)
+				{
+					const double c_t = calibrate(calibration_text);
+					if(i == 0 || c_t < calibration)
+						calibration = c_t;
+					
+					long peak;
+					const double t = run(binary, args, peak);
+					
+					if(i == 0 || t < best)
+						best = t;
+					if(peak > peak_kib)
+						peak_kib = peak;
+				}
+				
+				size_t events;
+				const uint64_t h = checksum(output, events);
+				const result_t r = {events / best * calibration, peak_kib, h};
+				results[c.name] = r;
+				
+				std::cout << c.name << ": " << static_cast<uint64_t>(events / best) << " events/s, " << static_cast<uint64_t>(r.events_per_s) << " per calibration, " << r.peak_kib << " KiB peak";
+				
+				if(record)
+				{
+					std::cout << std::endl;
+					continue;
+				}
+				
+				const auto g_i = golden.find(c.name);
+				if(g_i == golden.end() || g_i->second.empty() || std::stoull(g_i->second[0], nullptr, 16) != h)
+				{
+					std::cout << ", OUTPUT DIFFERS from golden";
+					failed = true;
+				}
+				
+				const auto b_i = baseline.find(c.name);
+				if(b_i == baseline.end() || b_i->second.size() < 2)
+				{
+					std::cout << ", no baseline";
+					failed = true;
+				}
+				else
+				{
+					const double base_events_per_s = std::stod(b_i->second[0]);
+					const double base_peak_kib = std::stod(b_i->second[1]);
+					
+					std::cout << " (baseline " << static_cast<uint64_t>(base_events_per_s) << " per calibration, " << base_peak_kib << " KiB)";
+					
+					if(r.events_per_s < base_events_per_s * (1 - tolerance))
+					{
+						std::cout << ", THROUGHPUT REGRESSED";
+						failed = true;
+					}
+					
+					if(r.peak_kib > base_peak_kib * (1 + tolerance))
+					{
+						std::cout << ", MEMORY REGRESSED";
+						failed = true;
+					}
+				}
+				
+				std::cout << std::endl;
+			}
+			
+			// Not part of the baseline: any allocation in steady state is a regression
+			const double per_state = allocations_per_state(trace + ".hr", 1000);
+			std::cout << "hr-allocations: " << per_state << " per state after warm-up";
+			if(per_state != 0 && !record)
+			{
+				std::cout << ", ALLOCATES";
+				failed = true;
+			}
+			std::cout << std::endl;
+			
+			if(record)
+			{
+				std::ofstream b(baseline_path), g(golden_path);
+				
+				b << "# <case> <events/s times the calibration time> <peak KiB>, recorded by perf_check --record\n";
+				g << "# <case> <FNV-1a checksum of the output>, recorded by perf_check --record\n";
+				
+				for(const case_t& c : cases)
+				{
+					const result_t& r = results[c.name];
+					b << c.name << " " << static_cast<uint64_t>(r.events_per_s) << " " << r.peak_kib << "\n";
+					g << c.name << " " << std::hex << r.checksum << std::dec << "\n";
+				}
+				
+				if(!b || !g)
+				{
+					std::cerr << "Failed to record the baseline in " << perf_dir << std::endl;
+					return 1;
+				}
+				
+				std::cout << "Recorded baseline and golden checksums in " << perf_dir << std::endl;
+				return 0;
+			}
+			
+			std::cout << (failed ? "Performance check failed" : "Performance check passed") << " (tolerance " << tolerance << ")" << std::endl;
+			return failed ? 1 : 0;
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		return uppaal2octopus::perf::main(argc, argv);
+	} catch(const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+}
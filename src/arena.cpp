@@ -0,0 +1,44 @@
+#include "arena.hpp"
+
+#include <algorithm>
+
+namespace uppaal2octopus
+{
+	arena::arena(const size_t block_size)
+	: blocks()
+	, block(0)
+	, offset(0)
+	, block_size(block_size)
+	{}
+	
+	void* arena::allocate(const size_t size, const size_t alignment)
+	{
+		for(; block < blocks.size(); block++, offset = 0)
+		{
+			block_t& b = blocks[block];
+			
+			const size_t misalignment = reinterpret_cast<size_t>(b.data.get() + offset) % alignment;
+			const size_t start = offset + (misalignment == 0 ? 0 : alignment - misalignment);
+			
+			if(start + size <= b.size)
+			{
+				offset = start + size;
+				return b.data.get() + start;
+			}
+		}
+		
+		// New blocks are aligned for any type, and large enough for oversized requests
+		const size_t new_size = std::max(block_size, size);
+		blocks.push_back({std::unique_ptr<char[]>(new char[new_size]), new_size});
+		
+		block = blocks.size() - 1;
+		offset = size;
+		return blocks.back().data.get();
+	}
+	
+	void arena::reset()
+	{
+		block = 0;
+		offset = 0;
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace uppaal2octopus
+{
+	/* Monotonic memory for objects that all die at the same point, like
+	 * those parsed from a single state. Allocating bumps an offset into the
+	 * current block and freeing does nothing; reset() reuses all blocks at
+	 * once. Blocks are kept over resets, so once the largest state has been
+	 * seen, parsing the others does not touch the heap.
+	 */
+	class arena
+	{
+		struct block_t
+		{
+			std::unique_ptr<char[]> data;
+			size_t size;
+		};
+		
+		std::vector<block_t> blocks;
+		size_t block, offset; // The block in use and the first free byte in it
+		size_t block_size;
+		
+		arena(arena&) = delete;
+		void operator=(arena&) = delete;
+	
+	public:
+		arena(const size_t block_size = 4096);
+		
+		void* allocate(const size_t size, const size_t alignment);
+		
+		// Release everything allocated so far.
+		void reset();
+	};
+	
+	// Allocates containers in an arena; they must not outlive its next reset.
+	template<typename T>
+	class arena_allocator
+	{
+		template<typename U>
+		friend class arena_allocator;
+		
+		arena* a;
+	
+	public:
+		typedef T value_type;
+		
+		arena_allocator(arena& a)
+		: a(&a)
+		{}
+		
+		template<typename U>
+		arena_allocator(const arena_allocator<U>& rhs)
+		: a(rhs.a)
+		{}
+		
+		T* allocate(const size_t n)
+		{
+			return static_cast<T*>(a->allocate(n * sizeof(T), alignof(T)));
+		}
+		
+		void deallocate(T*, const size_t)
+		{}
+		
+		template<typename U>
+		bool operator==(const arena_allocator<U>& rhs) const
+		{
+			return a == rhs.a;
+		}
+		
+		template<typename U>
+		bool operator!=(const arena_allocator<U>& rhs) const
+		{
+			return a != rhs.a;
+		}
+	};
+}
@@ -0,0 +1,93 @@
+#include "checkpoint.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace uppaal2octopus
+{
+	static const std::string checkpoint_magic = "u2ocp1";
+	
+	checkpoint::checkpoint()
+	: trace_size(0)
+	, input_offset(0)
+	, output_offset(0)
+	, parser()
+	, converter()
+	{}
+	
+	void checkpoint::save(const std::string& path) const
+	{
+		const std::string tmp = path + ".tmp";
+		
+		{
+			std::ofstream os(tmp, std::ios::binary);
+			write_string(os, checkpoint_magic);
+			write_uint(os, trace_size);
+			write_uint(os, input_offset);
+			write_uint(os, output_offset);
+			write_string(os, parser);
+			write_string(os, converter);
+			
+			if(!os.flush())
+				throw std::runtime_error(std::string("Failed to write checkpoint ") + tmp);
+		}
+		
+		if(rename(tmp.c_str(), path.c_str()) != 0)
+			throw std::runtime_error(std::string("Failed to replace checkpoint ") + path);
+	}
+	
+	void checkpoint::load(const std::string& path)
+	{
+		std::ifstream is(path, std::ios::binary);
+		if(!is)
+			throw std::runtime_error(std::string("Cannot open checkpoint ") + path);
+		
+		try
+		{
+			if(read_string(is) != checkpoint_magic)
+				throw std::runtime_error("");
+			
+			trace_size = read_uint(is);
+			input_offset = read_uint(is);
+			output_offset = read_uint(is);
+			parser = read_string(is);
+			converter = read_string(is);
+		} catch(const std::exception&)
+		{
+			throw std::runtime_error(std::string("Not a checkpoint: ") + path);
+		}
+	}
+	
+	void checkpoint::write_uint(std::ostream& os, const uint64_t x)
+	{
+		os.write(reinterpret_cast<const char*>(&x), sizeof(x));
+	}
+	
+	void checkpoint::write_string(std::ostream& os, const std::string& str)
+	{
+		write_uint(os, str.size());
+		os.write(str.data(), str.size());
+	}
+	
+	uint64_t checkpoint::read_uint(std::istream& is)
+	{
+		uint64_t x;
+		if(!is.read(reinterpret_cast<char*>(&x), sizeof(x)))
+			throw std::runtime_error("Truncated checkpoint");
+		
+		return x;
+	}
+	
+	std::string checkpoint::read_string(std::istream& is)
+	{
+		const uint64_t size = read_uint(is);
+		
+		std::string str;
+		str.resize(size);
+		if(size > 0 && !is.read(&str[0], size))
+			throw std::runtime_error("Truncated checkpoint");
+		
+		return str;
+	}
+}
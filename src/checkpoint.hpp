@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+
+namespace uppaal2octopus
+{
+	/* The progress of a conversion, from which it is resumed: how far the
+	 * trace was read and the output written, and the states of the parser
+	 * and the converter at that point, serialized by themselves.
+	 *
+	 * A checkpoint is saved to a temporary file that replaces the previous
+	 * one, so an interrupted save leaves the last checkpoint intact.
+	 */
+	class checkpoint
+	{
+	public:
+		uint64_t trace_size; // Refuses resuming with another trace
+		uint64_t input_offset, output_offset;
+		std::string parser, converter;
+		
+		checkpoint();
+		
+		void save(const std::string& path) const;
+		void load(const std::string& path);
+		
+		// Fields of serialized states, in native byte order.
+		static void write_uint(std::ostream& os, const uint64_t x);
+		static void write_string(std::ostream& os, const std::string& str);
+		static uint64_t read_uint(std::istream& is);
+		static std::string read_string(std::istream& is);
+	};
+}
@@ -0,0 +1,69 @@
+#include "chrome_writer.hpp"
+
+namespace uppaal2octopus
+{
+	chrome_writer::chrome_writer(std::ostream& os)
+	: os(os)
+	, threads()
+	, first(true)
+	{
+		os << "{\"traceEvents\":[\n";
+	}
+	
+	void chrome_writer::separator()
+	{
+		if(!first)
+			os << ",\n";
+		
+		first = false;
+	}
+	
+	void chrome_writer::string(const name_t& str)
+	{
+		static const char hex[] = "0123456789abcdef";
+		
+		os << '"';
+		for(const char c : str)
+		{
+			if(c == '"' || c == '\\')
+				os << '\\' << c;
+			else if(static_cast<unsigned char>(c) < 0x20)
+				os << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+			else
+				os << c;
+		}
+		os << '"';
+	}
+	
+	uint64_t chrome_writer::thread(const process_t& p)
+	{
+		const auto t_i = threads.find(p);
+		if(t_i != threads.end())
+			return t_i->second;
+		
+		const uint64_t tid = threads.size() + 1;
+		threads.insert(std::make_pair(p, tid));
+		
+		separator();
+		os << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":";
+		string(p);
+		os << "}}";
+		
+		return tid;
+	}
+	
+	void chrome_writer::add(const location_t& l, const clock_t start, const clock_t end)
+	{
+		const uint64_t tid = thread(l.first);
+		
+		separator();
+		os << "{\"name\":";
+		string(l.second);
+		os << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid << ",\"ts\":" << start << ",\"dur\":" << end - start << "}";
+	}
+	
+	void chrome_writer::finish()
+	{
+		os << "\n]}\n";
+	}
+}
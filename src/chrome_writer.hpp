@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+
+#include "concepts.hpp"
+
+namespace uppaal2octopus
+{
+	/* Writes intervals in the JSON trace event format of chrome://tracing,
+	 * also read by ui.perfetto.dev. Every process becomes a thread named
+	 * after it, and every interval a complete ("X") event, named after the
+	 * location. One unit of the clock is written as one microsecond.
+	 *
+	 * Events are streamed as they are added; finish closes the document.
+	 */
+	class chrome_writer
+	{
+		std::ostream& os;
+		std::map<process_t, uint64_t> threads;
+		bool first;
+		
+		chrome_writer(chrome_writer&) = delete;
+		void operator=(chrome_writer&) = delete;
+		
+		void separator();
+		void string(const name_t& str);
+		uint64_t thread(const process_t& p);
+	
+	public:
+		chrome_writer(std::ostream& os);
+		
+		void add(const location_t& l, const clock_t start, const clock_t end);
+		void finish();
+	};
+}
@@ -1,11 +1,32 @@
 #pragma once
 
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <boost/iostreams/device/mapped_file.hpp>
 #include <boost/program_options.hpp>
 
+#include "checkpoint.hpp"
+#include "chrome_writer.hpp"
 #include "converter.hpp"
+#include "differ.hpp"
+#include "event_format.hpp"
+#include "merger.hpp"
+#include "perfetto_writer.hpp"
+#include "server.hpp"
+#include "sorter.hpp"
+#include "timeline.hpp"
+#include "transition_log.hpp"
+#include "uppaal2octopus.hpp"
 
 #include "xtrparser.hpp"
 #include "hrparser.hpp"
+#include "interval_index.hpp"
+#include "xmlparser.hpp"
 
 namespace uppaal2octopus
 {
@@ -14,31 +35,273 @@ namespace uppaal2octopus
 		cli() = delete;
 		cli(cli&) = delete;
 		void operator=(cli&) = delete;
+		
+		// The states of a trace given as hr:<trace>, xml:<trace>:<model> or xtr:<trace>:<model>, loading each model once
+		static event_reader::source_t open_input(const library& lib, std::map<std::string, library::model_t>& models, const std::string& input, std::string& trace)
+		{
+			if(input.compare(0, 3, "hr:") == 0)
+			{
+				trace = input.substr(3);
+				return lib.source_hr(trace);
+			}
+			else if((input.compare(0, 4, "xml:") == 0 || input.compare(0, 4, "xtr:") == 0) && input.find(':', 4) != std::string::npos)
+			{
+				const size_t sep = input.find(':', 4);
+				const std::string model = input.substr(sep + 1);
+				trace = input.substr(4, sep - 4);
+				
+				if(models.find(model) == models.end())
+					models[model] = lib.load_model(model);
+				
+				if(input.compare(0, 4, "xml:") == 0)
+					return lib.source_xml(models[model], trace);
+				
+				return lib.source_xtr(models[model], trace);
+			}
+			
+			throw std::runtime_error("Unknown input '" + input + "', expected hr:<trace>, xml:<trace>:<model> or xtr:<trace>:<model>");
+		}
+	
+		static int merge(const std::vector<std::string>& inputs, const size_t threads, const filter& selection, const converter::callback_t& output)
+		{
+			library lib(threads, selection);
+			merger m;
+			
+			const auto ids = std::make_shared<converter::ids_t>();
+			std::map<std::string, library::model_t> models;
+			
+			for(size_t i = 0; i < inputs.size(); i++)
+			{
+				const std::string& input = inputs[i];
+				
+				try
+				{
+					std::string trace;
+					const event_reader::source_t source = open_input(lib, models, input, trace);
+					m.add(std::unique_ptr<event_reader>(new event_reader(source, std::to_string(i) + ":" + trace, ids)));
+				} catch(const std::exception& e)
+				{
+					std::cerr << e.what() << std::endl;
+					return -1;
+				}
+				
+				std::cerr << "Trace " << i << ": " << input << std::endl;
+			}
+			
+			octopus::event_t e;
+			while(m.next(e))
+				output(e);
+			
+			return 1;
+		}
+	
+		static int diff(const std::string& input_a, const std::string& input_b, const std::vector<std::string>& rest, const size_t threads, const size_t window, const filter& selection, std::ostream& out)
+		{
+			if(input_a == "" || input_b == "" || !rest.empty())
+			{
+				std::cerr << "Please specify two traces to compare, see --help" << std::endl;
+				return -1;
+			}
+			
+			library lib(threads, selection);
+			std::map<std::string, library::model_t> models;
+			
+			try
+			{
+				std::string trace;
+				const event_reader::source_t a = open_input(lib, models, input_a, trace);
+				const event_reader::source_t b = open_input(lib, models, input_b, trace);
+				
+				std::cerr
+					<< "Trace a: " << input_a << std::endl
+					<< "Trace b: " << input_b << std::endl;
+				
+				differ d(a, b, window);
+				d.run();
+				d.report(out);
+			} catch(const std::exception& e)
+			{
+				std::cerr << e.what() << std::endl;
+				return -1;
+			}
+			
+			return 1;
+		}
+	
+		static int submit(const std::string& socket, server::job_t job, std::ostream& out)
+		{
+			// The server does not share our working directory
+			for(std::string* p : {&job.trace, &job.model})
+				if(*p != "" && *p != "-" && (*p)[0] != '/')
+				{
+					char* cwd = getcwd(nullptr, 0);
+					*p = std::string(cwd) + "/" + *p;
+					free(cwd);
+				}
+			
+			if(job.trace == "-")
+			{
+				job.trace = "";
+				job.data.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+			}
+			
+			try
+			{
+				server::submit(socket, job, out);
+			} catch(const std::exception& e)
+			{
+				std::cerr << e.what() << std::endl;
+				return -1;
+			}
+			
+			return 1;
+		}
+	
+		static int query(const std::string& index, const std::string& time, const std::vector<std::string>& until, const filter& selection, const converter::callback_t& output)
+		{
+			if(index == "" || time == "" || until.size() > 1)
+			{
+				std::cerr << "Please specify an index and a time or range, see --help" << std::endl;
+				return -1;
+			}
+			
+			try
+			{
+				const clock_t from = static_cast<clock_t>(std::stoul(time));
+				const clock_t to = until.empty() ? from : static_cast<clock_t>(std::stoul(until[0]));
+				
+				index_reader(index).query(from, to, selection, output);
+			} catch(const std::invalid_argument&)
+			{
+				std::cerr << "Times must be numbers, see --help" << std::endl;
+				return -1;
+			} catch(const std::exception& e)
+			{
+				std::cerr << e.what() << std::endl;
+				return -1;
+			}
+			
+			return 1;
+		}
+	
+		static int convert_resumable(const xtrparser& p, const std::string& model_file, const std::string& trace_file, const std::string& checkpoint_file, const size_t interval, const checkpoint* resume, converter& c, const xtrparser::callback_t& f, std::ostream& out)
+		{
+			try
+			{
+				xtrparser::model_t m;
+				p.load(m, model_file);
+				
+				boost::iostreams::mapped_file_source trace(trace_file);
+				
+				if(resume)
+				{
+					std::stringstream s(resume->converter);
+					c.restore(s);
+				}
+				
+				checkpoint progress;
+				progress.trace_size = trace.size();
+				
+				auto saved = std::chrono::steady_clock::now();
+				const auto on_checkpoint = [&](const size_t offset, const std::string& state) {
+					const auto now = std::chrono::steady_clock::now();
+					if(now - saved < std::chrono::seconds(interval))
+						return;
+					
+					saved = now;
+					out.flush();
+					
+					progress.input_offset = offset;
+					progress.output_offset = static_cast<uint64_t>(out.tellp());
+					progress.parser = state;
+					
+					std::stringstream s;
+					c.save(s);
+					progress.converter = s.str();
+					
+					progress.save(checkpoint_file);
+				};
+				
+				if(resume)
+					p.parse(m, trace.data(), trace.size(), f, on_checkpoint, resume->input_offset, resume->parser);
+				else
+					p.parse(m, trace.data(), trace.size(), f, on_checkpoint);
+			} catch(const std::exception& e)
+			{
+				std::cerr << e.what() << std::endl;
+				return -1;
+			}
+			
+			// A finished conversion is not resumed
+			remove(checkpoint_file.c_str());
+			return 1;
+		}
 	
 	public:
 	
 		static int main(int argc, char** argv)
 		{
 			std::string action, model_file, trace_file;
+			std::vector<std::string> inputs;
+			size_t threads = 1;
+			size_t memory = 256;
+			std::string variables_file, clocks_file, transitions_file, index_file, checkpoint_file, output_file, socket;
+			size_t checkpoint_interval = 60;
+			std::string format = "octopus";
+			size_t models = 16;
+			size_t window = 64;
+			size_t fold_loops = 0;
+			std::vector<std::string> processes, excluded_processes, locations, excluded_locations;
 
 			boost::program_options::options_description o_general("General options");
 			o_general.add_options()
-			("help,h", "display this message");
+			("help,h", "display this message")
+			("threads,j", boost::program_options::value<decltype(threads)>(&threads), "number of threads decoding xtr states (0 for all cores, default 1)")
+			("sorted,s", "output events sorted by timestamp")
+			("memory,m", boost::program_options::value<decltype(memory)>(&memory), "memory budget in MiB for sorting before spilling to disk (default 256)")
+			("variables,V", boost::program_options::value<decltype(variables_file)>(&variables_file), "also write the variable values of every state to this file")
+			("clocks,C", boost::program_options::value<decltype(clocks_file)>(&clocks_file), "also write the lower bounds of all clocks in every state to this file")
+			("event-clocks", "add the lower bounds of all clocks where an interval ends to its end event (csv and jsonl only)")
+			("transitions,T", boost::program_options::value<decltype(transitions_file)>(&transitions_file), "also write the edges of every transition with their guards, synchronisations and updates to this file (hr only)")
+			("index,I", boost::program_options::value<decltype(index_file)>(&index_file), "also write an index of the events to this file, for query")
+			("validate", "check that every hr state matches the locations reached by the transitions")
+			("format,f", boost::program_options::value<decltype(format)>(&format), "output format: octopus for ResVis (default), csv, jsonl, perfetto or chrome")
+			("output,o", boost::program_options::value<decltype(output_file)>(&output_file), "write events to this file instead of the standard output")
+			("checkpoint", boost::program_options::value<decltype(checkpoint_file)>(&checkpoint_file), "periodically save the progress of an xtr conversion to --output in this file")
+			("checkpoint-interval", boost::program_options::value<decltype(checkpoint_interval)>(&checkpoint_interval), "seconds between checkpoints (default 60)")
+			("resume", "continue the conversion from the checkpoint")
+			("window", boost::program_options::value<decltype(window)>(&window), "number of locations per process looked ahead by diff to align the traces (default 64)")
+			("fold-loops", boost::program_options::value<decltype(fold_loops)>(&fold_loops), "fold locations repeating with the same durations, in cycles of up to this many locations per process, into one interval");
+			
+			boost::program_options::options_description o_server("Server options");
+			o_server.add_options()
+			("socket,S", boost::program_options::value<decltype(socket)>(&socket), "serve on, or submit conversions to, the server at this Unix socket")
+			("models", boost::program_options::value<decltype(models)>(&models), "number of models kept loaded by the server (default 16)");
+			
+			boost::program_options::options_description o_filter("Filter options");
+			o_filter.add_options()
+			("process,p", boost::program_options::value<decltype(processes)>(&processes), "only convert this process (repeatable)")
+			("exclude-process,P", boost::program_options::value<decltype(excluded_processes)>(&excluded_processes), "do not convert this process (repeatable)")
+			("location,l", boost::program_options::value<decltype(locations)>(&locations), "only convert locations matching this glob over <process>.<location> (repeatable)")
+			("exclude-location,L", boost::program_options::value<decltype(excluded_locations)>(&excluded_locations), "do not convert locations matching this glob (repeatable)")
+			("show-hidden", "also convert locations starting with '_'");
 			
 			boost::program_options::options_description o_hidden("Hidden options");
 			o_hidden.add_options()
-			("action", boost::program_options::value<decltype(trace_file)>(&action), "either xtr or hr")
+			("action", boost::program_options::value<decltype(trace_file)>(&action), "either xtr, hr, xml, merge, diff, query or serve")
 			("trace", boost::program_options::value<decltype(trace_file)>(&trace_file), "path to trace file in xtr")
-			("model", boost::program_options::value<decltype(model_file)>(&model_file), "path to model file in intermediate format");
+			("model", boost::program_options::value<decltype(model_file)>(&model_file), "path to model file in intermediate format")
+			("inputs", boost::program_options::value<decltype(inputs)>(&inputs), "further traces to merge");
 
 			boost::program_options::variables_map vm;
 			boost::program_options::positional_options_description pos;
 			pos.add("action", 1);
 			pos.add("trace", 1);
 			pos.add("model", 1);
+			pos.add("inputs", -1);
 			
 			boost::program_options::options_description options("Allowed options");
-			options.add(o_general).add(o_hidden);
+			options.add(o_general).add(o_filter).add(o_server).add(o_hidden);
 	
 			try
 			{
@@ -55,8 +318,17 @@ namespace uppaal2octopus
 					<< "Program for converting UPPAAL traces to Octopus traces. [https://github.com/Wassasin/uppaal2octopus]" << std::endl
 					<< "Usage: ./uppaal2octopus [options] xtr <model> <trace>" << std::endl
 					<< "       ./uppaal2octopus [options] hr <trace>" << std::endl
+					<< "       ./uppaal2octopus [options] xml <trace> <model>" << std::endl
+					<< "       ./uppaal2octopus [options] merge (hr:<trace> | xml:<trace>:<model> | xtr:<trace>:<model>)..." << std::endl
+					<< "       ./uppaal2octopus [options] diff <input> <input>" << std::endl
+					<< "       ./uppaal2octopus [options] query <index> <time> [<until>]" << std::endl
+					<< "       ./uppaal2octopus [options] -S <socket> serve" << std::endl
+					<< std::endl
+					<< o_general
 					<< std::endl
-					<< o_general;
+					<< o_filter
+					<< std::endl
+					<< o_server;
 				
 				return 0;
 			}
@@ -70,11 +342,342 @@ namespace uppaal2octopus
 				return -1;
 			}
 			
-			converter c([&](const octopus::event_t& e) {
-				std::cout << e << std::endl;
-			});
+			filter selection;
+			selection.set_show_hidden(vm.count("show-hidden"));
+			
+			for(const auto& p : processes)
+				selection.include_process(p);
+			for(const auto& p : excluded_processes)
+				selection.exclude_process(p);
+			for(const auto& l : locations)
+				selection.include_location(l);
+			for(const auto& l : excluded_locations)
+				selection.exclude_location(l);
 			
-			auto f = [&](const location_t loc, const clock_t clock, const startend_e startEnd) {
+			if(action == "serve")
+			{
+				if(socket == "")
+				{
+					std::cerr << "Please specify the socket to serve on, see --help" << std::endl;
+					return -1;
+				}
+				
+				try
+				{
+					server(socket, threads, models, memory << 20, selection).run();
+				} catch(const std::exception& e)
+				{
+					std::cerr << e.what() << std::endl;
+					return -1;
+				}
+				
+				return 1;
+			}
+			
+			if(fold_loops != 0 && ((action != "hr" && action != "xml" && action != "xtr") || socket != "" || checkpoint_file != ""))
+			{
+				std::cerr << "Loops can only be folded in hr, xml and xtr conversions without a server or checkpoints, see --help" << std::endl;
+				return -1;
+			}
+			
+			// Events are annotated as they are converted, with the clocks of the state just read
+			const bool event_clocks = vm.count("event-clocks");
+			if(event_clocks && ((action != "hr" && action != "xml" && action != "xtr") || (format != "csv" && format != "jsonl") || vm.count("sorted") || fold_loops != 0))
+			{
+				std::cerr << "Clocks can only be added to unsorted csv and jsonl events of hr, xml and xtr conversions without folding loops, see --help" << std::endl;
+				return -1;
+			}
+			
+			if(socket != "")
+			{
+				if(action != "hr" && action != "xml" && action != "xtr")
+				{
+					std::cerr << "Only hr, xml and xtr conversions can be submitted to a server, see --help" << std::endl;
+					return -1;
+				}
+				
+				if(variables_file != "" || clocks_file != "" || transitions_file != "" || index_file != "" || checkpoint_file != "" || format != "octopus")
+				{
+					std::cerr << "Variables, clocks, transitions, indices, checkpoints and other formats can not be exported by a server, see --help" << std::endl;
+					return -1;
+				}
+				
+				if(!processes.empty() || !excluded_processes.empty() || !locations.empty() || !excluded_locations.empty() || vm.count("show-hidden"))
+				{
+					std::cerr << "Filters of a server are set when starting it, see --help" << std::endl;
+					return -1;
+				}
+				
+				server::job_t job;
+				job.action = action;
+				job.trace = trace_file;
+				job.model = model_file;
+				job.sorted = vm.count("sorted");
+				
+				// The events are streamed back and written here, the server does not write files for us
+				std::ofstream file;
+				if(output_file != "")
+				{
+					file.open(output_file);
+					if(!file)
+					{
+						std::cerr << "Cannot open output " << output_file << std::endl;
+						return -1;
+					}
+				}
+				
+				return submit(socket, job, output_file != "" ? static_cast<std::ostream&>(file) : std::cout);
+			}
+			
+			const bool resume = vm.count("resume");
+			checkpoint progress;
+			
+			if(checkpoint_file != "")
+			{
+				if(action != "xtr" || output_file == "" || format != "octopus" || vm.count("sorted") || variables_file != "" || clocks_file != "" || index_file != "")
+				{
+					std::cerr << "Checkpoints are only supported for unsorted xtr conversions to an --output, see --help" << std::endl;
+					return -1;
+				}
+				
+				if(resume)
+				{
+					try
+					{
+						progress.load(checkpoint_file);
+					} catch(const std::runtime_error& e)
+					{
+						std::cerr << e.what() << std::endl;
+						return -1;
+					}
+					
+					// Only touch the output once the checkpoint is known to be of this conversion
+					struct stat trace_stat, output_stat;
+					if(stat(trace_file.c_str(), &trace_stat) != 0)
+					{
+						std::cerr << "Cannot open trace " << trace_file << std::endl;
+						return -1;
+					}
+					
+					if(static_cast<uint64_t>(trace_stat.st_size) != progress.trace_size)
+					{
+						std::cerr << "The checkpoint is of another trace than " << trace_file << std::endl;
+						return -1;
+					}
+					
+					if(stat(output_file.c_str(), &output_stat) != 0 || static_cast<uint64_t>(output_stat.st_size) < progress.output_offset)
+					{
+						std::cerr << "The checkpoint is of another output than " << output_file << std::endl;
+						return -1;
+					}
+					
+					// Drop the events written after the checkpoint
+					if(truncate(output_file.c_str(), static_cast<off_t>(progress.output_offset)) != 0)
+					{
+						std::cerr << "Cannot resume output " << output_file << std::endl;
+						return -1;
+					}
+				}
+			}
+			else if(resume)
+			{
+				std::cerr << "Please specify the checkpoint to resume from, see --help" << std::endl;
+				return -1;
+			}
+			
+			std::ofstream output_stream;
+			if(output_file != "")
+			{
+				if(resume)
+				{
+					output_stream.open(output_file, std::ios::in | std::ios::out);
+					output_stream.seekp(static_cast<std::streamoff>(progress.output_offset));
+				}
+				else
+					output_stream.open(output_file);
+				
+				if(!output_stream)
+				{
+					std::cerr << "Cannot open output " << output_file << std::endl;
+					return -1;
+				}
+			}
+			
+			std::ostream& out = output_file != "" ? output_stream : std::cout;
+			
+			if(action == "diff")
+			{
+				if(vm.count("sorted") || variables_file != "" || clocks_file != "" || transitions_file != "" || index_file != "" || format != "octopus")
+				{
+					std::cerr << "A diff is only written as a report, see --help" << std::endl;
+					return -1;
+				}
+				
+				return diff(trace_file, model_file, inputs, threads, window, selection, out);
+			}
+			
+			// Events are written in one of the event formats, chosen here once
+			const bool events_format = format == "octopus" || format == "csv" || format == "jsonl";
+			std::unique_ptr<event_writer<tsv_format>> tsv;
+			std::unique_ptr<event_writer<csv_format>> csv;
+			std::unique_ptr<event_writer<jsonl_format>> jsonl;
+			converter::callback_t print;
+			clock_values_t clock_values;
+			
+			if(format == "csv")
+			{
+				csv.reset(new event_writer<csv_format>(out, event_clocks ? &clock_values : nullptr));
+				print = [&](const octopus::event_t& e) {
+					csv->add(e);
+				};
+			}
+			else if(format == "jsonl")
+			{
+				jsonl.reset(new event_writer<jsonl_format>(out, event_clocks ? &clock_values : nullptr));
+				print = [&](const octopus::event_t& e) {
+					jsonl->add(e);
+				};
+			}
+			else
+			{
+				tsv.reset(new event_writer<tsv_format>(out));
+				print = [&](const octopus::event_t& e) {
+					tsv->add(e);
+				};
+			}
+			
+			if(action == "query")
+				return query(trace_file, model_file, inputs, selection, print);
+			
+			// A merge is ordered by the end of the intervals, so it is always sorted
+			const bool sorted = vm.count("sorted") || action == "merge";
+			sorter s(print, memory << 20);
+			
+			const converter::callback_t unindexed = !sorted ? print : [&](const octopus::event_t& e) {
+				s.add(e);
+			};
+			
+			index_writer index(memory << 20);
+			const converter::callback_t output = index_file == "" ? unindexed : [&](const octopus::event_t& e) {
+				index.add(e);
+				unindexed(e);
+			};
+			
+			// The trace formats take the intervals directly, without Octopus events
+			std::unique_ptr<perfetto_writer> perfetto;
+			std::unique_ptr<chrome_writer> chrome;
+			converter::interval_callback_t on_interval = nullptr;
+			
+			if(!events_format)
+			{
+				if(sorted || action == "merge" || index_file != "")
+				{
+					std::cerr << "Only the octopus, csv and jsonl formats can be sorted, merged or indexed, see --help" << std::endl;
+					return -1;
+				}
+				
+				if(format == "perfetto")
+				{
+					perfetto.reset(new perfetto_writer(out));
+					on_interval = [&](const location_t& l, const clock_t start, const clock_t end) {
+						perfetto->add(l, start, end);
+					};
+				}
+				else if(format == "chrome")
+				{
+					chrome.reset(new chrome_writer(out));
+					on_interval = [&](const location_t& l, const clock_t start, const clock_t end) {
+						chrome->add(l, start, end);
+					};
+				}
+				else
+				{
+					std::cerr << "Unknown format '" << format << "', see --help" << std::endl;
+					return -1;
+				}
+			}
+			
+			converter c(output, on_interval);
+			if(fold_loops != 0)
+				c.fold_loops(fold_loops);
+			
+			// The timelines are written while the trace is parsed
+			std::ofstream variables_stream;
+			timeline variables(variables_stream);
+			hrparser::state_callback_t on_state = nullptr;
+			if(variables_file != "")
+			{
+				if(action == "merge")
+				{
+					std::cerr << "Variables can not be exported when merging, see --help" << std::endl;
+					return -1;
+				}
+				
+				variables_stream.open(variables_file);
+				if(!variables_stream)
+				{
+					std::cerr << "Cannot open variables " << variables_file << std::endl;
+					return -1;
+				}
+				
+				on_state = [&](const clock_t clock, const std::vector<std::string>& names, const std::vector<int>& values) {
+					variables.add(clock, names, values);
+				};
+			}
+			
+			std::ofstream clocks_stream;
+			timeline clocks(clocks_stream);
+			xtrparser::clocks_callback_t on_clocks = nullptr;
+			if(event_clocks)
+			{
+				on_clocks = [&](const clock_t clock, const std::vector<std::string>& names, const std::vector<int>& values) {
+					if(clock_values.names.size() != names.size())
+						clock_values.names = names;
+					
+					clock_values.values = values;
+					
+					if(clocks_file != "")
+						clocks.add(clock, names, values);
+				};
+			}
+			
+			if(clocks_file != "")
+			{
+				if(action != "xtr" && action != "hr" && action != "xml")
+				{
+					std::cerr << "Clocks can only be exported from xtr, hr and xml traces, see --help" << std::endl;
+					return -1;
+				}
+				
+				clocks_stream.open(clocks_file);
+				if(!clocks_stream)
+				{
+					std::cerr << "Cannot open clocks " << clocks_file << std::endl;
+					return -1;
+				}
+				
+				if(!on_clocks)
+					on_clocks = [&](const clock_t clock, const std::vector<std::string>& names, const std::vector<int>& values) {
+						clocks.add(clock, names, values);
+					};
+			}
+			
+			transition_log transitions;
+			hrparser::transition_callback_t on_transition = nullptr;
+			if(transitions_file != "")
+			{
+				if(action != "hr")
+				{
+					std::cerr << "Transitions can only be exported from hr traces, see --help" << std::endl;
+					return -1;
+				}
+				
+				on_transition = [&](const clock_t clock, const std::vector<std::vector<std::string>>& edges) {
+					transitions.add(clock, edges);
+				};
+			}
+			
+			auto f = [&](const location_t& loc, const clock_t clock, const startend_e startEnd) {
 				c.add(loc, clock, startEnd);
 			};
 			
@@ -90,9 +693,15 @@ namespace uppaal2octopus
 					<< "Model: " << model_file << std::endl
 					<< "Trace: " << trace_file << std::endl;
 			
-				xtrparser p;
-				p.parse(model_file, trace_file, f);
+				xtrparser p(threads, selection, on_state, on_clocks);
+				
+				if(checkpoint_file == "")
+					p.parse(model_file, trace_file, f);
+				else if(convert_resumable(p, model_file, trace_file, checkpoint_file, checkpoint_interval, resume ? &progress : nullptr, c, f, out) < 0)
+					return -1;
+				
 				c.flush();
+				s.flush();
 			}
 			else if(action == "hr")
 			{
@@ -104,13 +713,125 @@ namespace uppaal2octopus
 				
 				std::cerr << "Trace: " << trace_file << std::endl;
 				
-				hrparser::parse(trace_file, f);
+				try
+				{
+					hrparser::parse(trace_file, f, selection, on_state, on_transition, vm.count("validate"), on_clocks);
+				} catch(const std::runtime_error& e)
+				{
+					std::cerr << e.what() << std::endl;
+					return -1;
+				}
+				
 				c.flush();
+				s.flush();
+			}
+			else if(action == "xml")
+			{
+				if(model_file == "" || trace_file == "")
+				{
+					std::cerr << "Please specify both a trace in XML and a model, see --help" << std::endl;
+					return -1;
+				}
+				
+				std::cerr
+					<< "Model: " << model_file << std::endl
+					<< "Trace: " << trace_file << std::endl;
+				
+				try
+				{
+					xtrparser::model_t m;
+					xtrparser(1, selection).load(m, model_file);
+					
+					xmlparser::parse(m, trace_file, f, selection, on_state, on_clocks);
+				} catch(const std::runtime_error& e)
+				{
+					std::cerr << e.what() << std::endl;
+					return -1;
+				}
+				
+				c.flush();
+				s.flush();
+			}
+			else if(action == "merge")
+			{
+				// The first inputs end up in the positional trace and model options
+				std::vector<std::string> all;
+				for(const std::string& input : {trace_file, model_file})
+					if(input != "")
+						all.push_back(input);
+				
+				all.insert(all.end(), inputs.begin(), inputs.end());
+				
+				if(all.empty())
+				{
+					std::cerr << "Please specify the traces to merge, see --help" << std::endl;
+					return -1;
+				}
+				
+				if(merge(all, threads, selection, output) < 0)
+					return -1;
+				
+				s.flush();
 			}
 			else if(action == "")
+			{
 				std::cerr << "Specify an action, see --help" << std::endl;
+				return 1;
+			}
 			else
+			{
 				std::cerr << "Unknown action '" << action << "', see --help" << std::endl;
+				return 1;
+			}
+			
+			if(chrome)
+				chrome->finish();
+			
+			if(index_file != "")
+			{
+				try
+				{
+					index.write(index_file);
+				} catch(const std::runtime_error& e)
+				{
+					std::cerr << e.what() << std::endl;
+					return -1;
+				}
+			}
+			
+			if(variables_file != "")
+			{
+				variables.flush();
+				
+				if(!variables_stream)
+				{
+					std::cerr << "Failed to write variables to " << variables_file << std::endl;
+					return -1;
+				}
+			}
+			
+			if(clocks_file != "")
+			{
+				clocks.flush();
+				
+				if(!clocks_stream)
+				{
+					std::cerr << "Failed to write clocks to " << clocks_file << std::endl;
+					return -1;
+				}
+			}
+			
+			if(transitions_file != "")
+			{
+				std::ofstream os(transitions_file);
+				transitions.write(os);
+				
+				if(!os)
+				{
+					std::cerr << "Failed to write transitions to " << transitions_file << std::endl;
+					return -1;
+				}
+			}
 				
 			return 1;
 		}
@@ -2,12 +2,28 @@
 
 #include <string>
 
+#ifdef UPPAAL2OCTOPUS_NAME_VIEWS
+#include <boost/utility/string_ref.hpp>
+#endif
+
 namespace uppaal2octopus
 {
 	typedef uint32_t clock_t;
 	
-	typedef std::string process_t;
-	typedef std::string location_name_t;
+#ifdef UPPAAL2OCTOPUS_NAME_VIEWS
+	/* Names refer to the storage of the parser producing them, without
+	 * copying: the model for xtr, the names resolved while parsing for hr
+	 * and xml. They are valid for as long as the parser (and its model)
+	 * lives. Parsers end every location they started once a trace is done,
+	 * so a converter does not use the names of a finished trace.
+	 */
+	typedef boost::string_ref name_t;
+#else
+	typedef std::string name_t;
+#endif
+	
+	typedef name_t process_t;
+	typedef name_t location_name_t;
 	
 	typedef std::pair<process_t, location_name_t> location_t;
 	
@@ -3,65 +3,103 @@
 #include <sstream>
 #include <stdexcept>
 
+#include "checkpoint.hpp"
+
 namespace uppaal2octopus
 {
+	converter::ids_t::ids_t()
+	: next_event_id(0)
+	, next_location_id(30) //May not be < 30, ResVis dies in this case
+	{}
+
 	converter::converter(const converter::callback_t& f)
+	: converter(f, "UPPAALtrace", std::make_shared<ids_t>())
+	{}
+
+	converter::converter(const converter::callback_t& f, const converter::interval_callback_t& on_interval)
+	: converter(f)
+	{
+		this->on_interval = on_interval;
+	}
+
+	converter::converter(const converter::callback_t& f, const std::string& scenario, const std::shared_ptr<ids_t>& ids)
 	: f(f)
+	, on_interval()
+	, scenario(scenario)
+	, ids(ids)
 	, last(0)
-	, next_event_id(0)
-	, next_location_id(30) //May not be < 30, ResVis dies in this case
 	, events()
-	, location_ids()
+	, locations()
+	, restored_names()
+	, loops()
 	{}
 
-	converter::location_id_t converter::get_location_id(const location_t l)
+	converter::location_info_t converter::describe(const location_id_t id, const location_t& l)
+	{
+		std::stringstream s;
+		s << id << ":" << l.first << "." << l.second; //Prepending with unique id makes ResVis happy
+		
+		const location_info_t info = {id, s.str(), std::string(l.first.data(), l.first.size())};
+		return info;
+	}
+	
+	const converter::location_info_t& converter::get_location(const location_t& l)
 	{
-		const auto l_id_i = location_ids.find(l);
+		const auto l_i = locations.find(l);
 		
-		if(l_id_i != location_ids.end())
-			return l_id_i->second;
+		if(l_i != locations.end())
+			return l_i->second;
 		
-		return location_ids[l] = next_location_id++;
+		return locations.insert(std::make_pair(l, describe(ids->next_location_id++, l))).first->second;
 	}
 	
 	void converter::output(const converter::event_t& e, clock_t end)
 	{
 		if(end - e.start == 0)
 			return;
+		
+		if(loops)
+			loops->add(e.l, e.start, end);
+		else
+			emit(e.l, e.start, end);
+	}
 	
-		if(e.l.second.size() < 1 || e.l.second[0] == '_')
+	void converter::emit(const location_t& l, const clock_t start, const clock_t end)
+	{
+		if(on_interval)
+		{
+			on_interval(l, start, end);
 			return;
+		}
 	
-		const event_id_t i = next_event_id++;
-		const location_id_t loc_id = get_location_id(e.l);
-	
-		std::stringstream s;
-		s << loc_id << ":" << e.l.first << "." << e.l.second; //Prepending with unique id makes ResVis happy
+		const event_id_t i = ids->next_event_id++;
+		const location_info_t& loc = get_location(l);
 	
-		f({
-			s.str(), // Because UPPAAL does not have the concept of Jobs, we abuse this field to contain the stateId, alongside with a textual respresentation of the state
-			static_cast<uint32_t>(loc_id), // No such thing as a pageNum, thus use locationId
-			"UPPAALtrace",
-			e.l.first,
+		octopus::event_t e = {
+			loc.label, // Because UPPAAL does not have the concept of Jobs, we abuse this field to contain the stateId, alongside with a textual respresentation of the state
+			static_cast<uint32_t>(loc.id), // No such thing as a pageNum, thus use locationId
+			scenario,
+			loc.resource,
 			static_cast<uint32_t>(i), // Unique identifier for start/end pair
 			startend_e::start,
-			e.start,
-			s.str()
-		});
-	
-		f({
-			s.str(),
-			static_cast<uint32_t>(loc_id),
-			"UPPAALtrace",
-			e.l.first,
-			static_cast<uint32_t>(i),
-			startend_e::end,
-			end,
-			s.str()
-		});
+			start,
+			loc.label
+		};
+		f(e);
+		
+		e.startEnd = startend_e::end;
+		e.timeStamp = end;
+		f(e);
 	}
 
-	void converter::add(location_t loc, clock_t clock, startend_e startEnd)
+	void converter::fold_loops(const size_t max_period)
+	{
+		loops.reset(new loop_folder([this](const location_t& l, const clock_t start, const clock_t end) {
+			emit(l, start, end);
+		}, max_period));
+	}
+	
+	void converter::add(const location_t& loc, clock_t clock, startend_e startEnd)
 	{
 		const auto e_i = events.find(loc.first);
 		if(e_i == events.end())
@@ -73,21 +111,75 @@ namespace uppaal2octopus
 			return;
 		}
 
-		const event_t e = e_i->second;
-		
-		output(e, clock);
+		output(e_i->second, clock);
 			
 		if(clock > last)
 			last = clock;
 		
-		events.erase(loc.first);
+		events.erase(e_i);
 	}
 	
 	void converter::flush()
 	{
-		for(const auto ep : events)
+		for(const auto& ep : events)
 			output(ep.second, last);
 		
 		events.clear();
+		
+		if(loops)
+			loops->flush();
+	}
+	
+	void converter::save(std::ostream& os) const
+	{
+		checkpoint::write_uint(os, ids->next_event_id);
+		checkpoint::write_uint(os, ids->next_location_id);
+		checkpoint::write_uint(os, last);
+		
+		checkpoint::write_uint(os, events.size());
+		for(const auto& ep : events)
+		{
+			checkpoint::write_string(os, std::string(ep.second.l.first.data(), ep.second.l.first.size()));
+			checkpoint::write_string(os, std::string(ep.second.l.second.data(), ep.second.l.second.size()));
+			checkpoint::write_uint(os, ep.second.start);
+		}
+		
+		checkpoint::write_uint(os, locations.size());
+		for(const auto& lp : locations)
+		{
+			checkpoint::write_string(os, std::string(lp.first.first.data(), lp.first.first.size()));
+			checkpoint::write_string(os, std::string(lp.first.second.data(), lp.first.second.size()));
+			checkpoint::write_uint(os, lp.second.id);
+		}
+	}
+	
+	name_t converter::restore_name(std::istream& is)
+	{
+		restored_names.push_back(checkpoint::read_string(is));
+		return name_t(restored_names.back());
+	}
+	
+	void converter::restore(std::istream& is)
+	{
+		ids->next_event_id = checkpoint::read_uint(is);
+		ids->next_location_id = checkpoint::read_uint(is);
+		last = static_cast<clock_t>(checkpoint::read_uint(is));
+		
+		events.clear();
+		for(uint64_t n = checkpoint::read_uint(is); n > 0; n--)
+		{
+			const name_t process = restore_name(is);
+			const location_t l(process, restore_name(is));
+			const event_t e = {l, static_cast<clock_t>(checkpoint::read_uint(is))};
+			events.insert(std::make_pair(l.first, e));
+		}
+		
+		locations.clear();
+		for(uint64_t n = checkpoint::read_uint(is); n > 0; n--)
+		{
+			const name_t process = restore_name(is);
+			const location_t l(process, restore_name(is));
+			locations.insert(std::make_pair(l, describe(checkpoint::read_uint(is), l)));
+		}
 	}
 }
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <deque>
 #include <functional>
+#include <istream>
 #include <map>
+#include <memory>
+#include <ostream>
 #include <string>
 
 #include "concepts.hpp"
+#include "loop_folder.hpp"
 #include "octopus.hpp"
 
 namespace uppaal2octopus
@@ -13,9 +18,21 @@ namespace uppaal2octopus
 	{
 	public:
 		typedef std::function<void(const octopus::event_t&)> callback_t;
+		
+		// A location that was active from start to end, for outputs without Octopus events
+		typedef std::function<void(const location_t& l, const clock_t start, const clock_t end)> interval_callback_t;
 	
 		typedef size_t event_id_t;
 		typedef size_t location_id_t;
+		
+		// Id counters, which can be shared to keep ids unique over several traces.
+		struct ids_t
+		{
+			event_id_t next_event_id;
+			location_id_t next_location_id;
+			
+			ids_t();
+		};
 
 	private:
 		struct event_t
@@ -23,25 +40,52 @@ namespace uppaal2octopus
 			location_t l;
 			clock_t start;
 		};
+		
+		// The id of a location, with its label and resource built once
+		struct location_info_t
+		{
+			location_id_t id;
+			std::string label, resource;
+		};
 	
 	private:
 		callback_t f;
+		interval_callback_t on_interval;
+		std::string scenario;
+		std::shared_ptr<ids_t> ids;
 	
 		clock_t last;
-		event_id_t next_event_id;
-		location_id_t next_location_id;
 		
 		std::map<process_t, event_t> events;
-		std::map<location_t, location_id_t> location_ids;
+		std::map<location_t, location_info_t> locations;
 		
-		location_id_t get_location_id(const location_t l);
+		std::deque<std::string> restored_names; // Referred to by restored names, if they are views
+		
+		std::unique_ptr<loop_folder> loops; // Of the finished intervals, if folded
+		
+		name_t restore_name(std::istream& is);
+		
+		static location_info_t describe(const location_id_t id, const location_t& l);
+		const location_info_t& get_location(const location_t& l);
 		
 		void output(const event_t& e, clock_t end);
+		void emit(const location_t& l, const clock_t start, const clock_t end);
 		
 	public:
 		converter(const callback_t& f);
 		
-		void add(location_t loc, clock_t clock, startend_e startEnd);
+		// Intervals are passed to on_interval, if set, instead of building events for f.
+		converter(const callback_t& f, const interval_callback_t& on_interval);
+		converter(const callback_t& f, const std::string& scenario, const std::shared_ptr<ids_t>& ids);
+		
+		// Fold repeated sequences of up to max_period locations per process into one interval.
+		void fold_loops(const size_t max_period);
+		
+		void add(const location_t& loc, clock_t clock, startend_e startEnd);
 		void flush();
+		
+		// The started events, location ids and counters, to continue a conversion from.
+		void save(std::ostream& os) const;
+		void restore(std::istream& is);
 	};
 }
@@ -0,0 +1,137 @@
+#include "dbm.hpp"
+
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DBM_X86
+#include <immintrin.h>
+#endif
+
+namespace uppaal2octopus
+{
+	/* Lower the distances to those through a clock at distance via, given
+	 * its row; n is a multiple of 8. Returns whether any distance changed.
+	 */
+	typedef bool (*relax_t)(int32_t* distances, const int32_t* row, const int32_t via, const size_t n);
+	
+	bool relax_scalar(int32_t* distances, const int32_t* row, const int32_t via, const size_t n)
+	{
+		bool changed = false;
+		for(size_t j = 0; j < n; j++)
+		{
+			const int32_t d = via + row[j];
+			if(d < distances[j])
+			{
+				distances[j] = d;
+				changed = true;
+			}
+		}
+		
+		return changed;
+	}
+
+#ifdef DBM_X86
+	__attribute__((target("sse4.1"))) bool relax_sse41(int32_t* distances, const int32_t* row, const int32_t via, const size_t n)
+	{
+		const __m128i v = _mm_set1_epi32(via);
+		__m128i changed = _mm_setzero_si128();
+		
+		for(size_t j = 0; j < n; j += 4)
+		{
+			__m128i* p = reinterpret_cast<__m128i*>(distances + j);
+			const __m128i d = _mm_loadu_si128(p);
+			const __m128i through = _mm_add_epi32(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + j)));
+			
+			changed = _mm_or_si128(changed, _mm_cmplt_epi32(through, d));
+			_mm_storeu_si128(p, _mm_min_epi32(d, through));
+		}
+		
+		return _mm_movemask_epi8(changed) != 0;
+	}
+	
+	__attribute__((target("avx2"))) bool relax_avx2(int32_t* distances, const int32_t* row, const int32_t via, const size_t n)
+	{
+		const __m256i v = _mm256_set1_epi32(via);
+		__m256i changed = _mm256_setzero_si256();
+		
+		for(size_t j = 0; j < n; j += 8)
+		{
+			__m256i* p = reinterpret_cast<__m256i*>(distances + j);
+			const __m256i d = _mm256_loadu_si256(p);
+			const __m256i through = _mm256_add_epi32(v, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + j)));
+			
+			changed = _mm256_or_si256(changed, _mm256_cmpgt_epi32(d, through));
+			_mm256_storeu_si256(p, _mm256_min_epi32(d, through));
+		}
+		
+		return _mm256_movemask_epi8(changed) != 0;
+	}
+#endif
+	
+	struct relax_isa_t
+	{
+		const char* name;
+		relax_t relax;
+	};
+	
+	relax_isa_t inline select_relax()
+	{
+#ifdef DBM_X86
+		__builtin_cpu_init();
+		
+		if(__builtin_cpu_supports("avx2"))
+			return {"avx2", relax_avx2};
+		
+		if(__builtin_cpu_supports("sse4.1"))
+			return {"sse4.1", relax_sse41};
+#endif
+		return {"scalar", relax_scalar};
+	}
+	
+	static const relax_isa_t selected_relax = select_relax();
+	
+	const int32_t dbm::infinity;
+	
+	dbm::dbm(const size_t n)
+	: n(n)
+	, stride((n + 7) & ~static_cast<size_t>(7))
+	, matrix(n * stride)
+	, distances(stride)
+	{
+		clear();
+	}
+	
+	const char* dbm::isa()
+	{
+		return selected_relax.name;
+	}
+	
+	void dbm::clear()
+	{
+		std::fill(matrix.begin(), matrix.end(), infinity);
+		for(size_t i = 0; i < n; i++)
+			matrix[i * stride + i] = 0;
+	}
+	
+	void dbm::lower_bounds(const size_t reference, std::vector<int>& result)
+	{
+		std::copy(matrix.begin() + static_cast<ptrdiff_t>(reference * stride), matrix.begin() + static_cast<ptrdiff_t>((reference + 1) * stride), distances.begin());
+		
+		// Without negative cycles, all shortest paths are found within n - 1 rounds
+		for(size_t round = 1; round < n; round++)
+		{
+			bool changed = false;
+			for(size_t k = 0; k < n; k++)
+				if(distances[k] < infinity / 2)
+					changed |= selected_relax.relax(distances.data(), matrix.data() + k * stride, distances[k], stride);
+			
+			if(!changed)
+				break;
+		}
+		
+		// Sums with infinite entries stay above infinity / 2, as long as bounds are below it
+		result.resize(n);
+		for(size_t j = 0; j < n; j++)
+			result[j] = distances[j] < infinity / 2 ? -distances[j] : 0;
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace uppaal2octopus
+{
+	/* A dense difference bound matrix over n clocks, where entry (i, j)
+	 * bounds i - j. Strictness is not kept, only the values.
+	 *
+	 * The lower bounds of all clocks relative to a reference clock follow
+	 * from the shortest paths from the reference: a path of weight w to j
+	 * gives reference - j <= w. These are found in one Bellman-Ford
+	 * relaxation, where relaxing over clock k takes the minimum of the
+	 * distances and those through k for a whole row at once, with SSE4.1
+	 * or AVX2 when available.
+	 */
+	class dbm
+	{
+		size_t n, stride; // Rows are padded to a multiple of 8 with infinite entries
+		std::vector<int32_t> matrix;
+		std::vector<int32_t> distances;
+	
+	public:
+		// An unbounded entry; distances above half of it are unbounded too
+		static const int32_t infinity = 0x3fffffff;
+		
+		dbm(const size_t n);
+		
+		// Make all entries unbounded, except the diagonal.
+		void clear();
+		
+		void set(const size_t i, const size_t j, const int32_t bound)
+		{
+			matrix[i * stride + j] = bound;
+		}
+		
+		// The lower bound of every clock relative to reference, 0 where none is implied.
+		void lower_bounds(const size_t reference, std::vector<int>& result);
+		
+		// The instruction set relaxing rows: "avx2", "sse4.1" or "scalar".
+		static const char* isa();
+	};
+}
@@ -0,0 +1,229 @@
+#include "differ.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace uppaal2octopus
+{
+	differ::interval_t::interval_t()
+	: location()
+	, start(0)
+	, end(0)
+	{}
+	
+	differ::interval_t::interval_t(const std::string& location, const clock_t start, const clock_t end)
+	: location(location)
+	, start(start)
+	, end(end)
+	{}
+	
+	differ::summary_t::summary_t()
+	: matched(0)
+	, only_a(0)
+	, only_b(0)
+	, start_delta_sum(0)
+	, start_delta_max(0)
+	, duration_delta_sum(0)
+	, duration_delta_max(0)
+	{}
+	
+	differ::divergence_t::divergence_t()
+	: found(false)
+	, process()
+	, clock(0)
+	, has_a(false)
+	, has_b(false)
+	, a()
+	, b()
+	{}
+	
+	differ::side_t::side_t(const event_reader::source_t& source, const converter::interval_callback_t& on_interval)
+	: source(source)
+	, c(nullptr, on_interval)
+	, done(false)
+	{}
+	
+	differ::process_state_t::process_state_t()
+	: a()
+	, b()
+	, summary()
+	{}
+	
+	differ::differ(const event_reader::source_t& a, const event_reader::source_t& b, const size_t window)
+	: window(window)
+	, a(a, [this](const location_t& l, const clock_t start, const clock_t end) {
+		add(true, l, start, end);
+	})
+	, b(b, [this](const location_t& l, const clock_t start, const clock_t end) {
+		add(false, l, start, end);
+	})
+	, processes()
+	, first()
+	, lengths()
+	{
+		// Lengths of common subsequences are at most the window
+		if(window == 0 || window > UINT16_MAX)
+			throw std::runtime_error("The window must be between 1 and 65535 locations");
+	}
+	
+	void differ::add(const bool in_a, const location_t& l, const clock_t start, const clock_t end)
+	{
+		const std::string process(l.first.begin(), l.first.end());
+		process_state_t& p = processes[process];
+		
+		(in_a ? p.a : p.b).emplace_back(std::string(l.second.begin(), l.second.end()), start, end);
+		align(process, p, false);
+	}
+	
+	void differ::step(differ::side_t& s)
+	{
+		if(s.done)
+			return;
+		
+		const event_reader::location_callback_t f = [&s](const location_t& loc, const clock_t clock, const startend_e startEnd) {
+			s.c.add(loc, clock, startEnd);
+		};
+		
+		if(!s.source(f))
+		{
+			s.c.flush();
+			s.done = true;
+		}
+	}
+	
+	void differ::align(const std::string& process, differ::process_state_t& p, const bool final)
+	{
+		while(!p.a.empty() || !p.b.empty())
+		{
+			if(!p.a.empty() && !p.b.empty() && p.a.front().location == p.b.front().location)
+			{
+				const interval_t& x = p.a.front();
+				const interval_t& y = p.b.front();
+				
+				const int64_t start_delta = static_cast<int64_t>(y.start) - static_cast<int64_t>(x.start);
+				const int64_t duration_delta = static_cast<int64_t>(y.end - y.start) - static_cast<int64_t>(x.end - x.start);
+				
+				summary_t& s = p.summary;
+				s.matched++;
+				s.start_delta_sum += start_delta;
+				s.duration_delta_sum += duration_delta;
+				
+				if(std::llabs(start_delta) > std::llabs(s.start_delta_max))
+					s.start_delta_max = start_delta;
+				if(std::llabs(duration_delta) > std::llabs(s.duration_delta_max))
+					s.duration_delta_max = duration_delta;
+				
+				p.a.pop_front();
+				p.b.pop_front();
+				continue;
+			}
+			
+			// A mismatch is settled once both windows are full or complete, or when one side runs two windows ahead
+			const bool a_ready = p.a.size() >= window || a.done, b_ready = p.b.size() >= window || b.done;
+			if(!final && !(a_ready && b_ready) && p.a.size() < 2 * window && p.b.size() < 2 * window)
+				return;
+			
+			const interval_t* x = p.a.empty() ? nullptr : &p.a.front();
+			const interval_t* y = p.b.empty() ? nullptr : &p.b.front();
+			
+			if(skip_a(p))
+			{
+				diverge(process, x, y, x->start);
+				p.summary.only_a++;
+				p.a.pop_front();
+			}
+			else
+			{
+				diverge(process, x, y, y->start);
+				p.summary.only_b++;
+				p.b.pop_front();
+			}
+		}
+	}
+	
+	bool differ::skip_a(const differ::process_state_t& p)
+	{
+		const size_t n = std::min(p.a.size(), window), m = std::min(p.b.size(), window);
+		if(n == 0 || m == 0)
+			return m == 0;
+		
+		// lengths[i][j] is the length of the LCS of a[i..n) and b[j..m)
+		const size_t columns = m + 1;
+		lengths.assign((n + 1) * columns, 0);
+		
+		for(size_t i = n; i-- > 0;)
+			for(size_t j = m; j-- > 0;)
+				lengths[i * columns + j] = p.a[i].location == p.b[j].location
+					? static_cast<uint16_t>(lengths[(i + 1) * columns + j + 1] + 1)
+					: std::max(lengths[(i + 1) * columns + j], lengths[i * columns + j + 1]);
+		
+		// Keep the head which leaves the longest subsequence, preferring to keep b on a tie
+		return lengths[columns] >= lengths[1];
+	}
+	
+	void differ::diverge(const std::string& process, const differ::interval_t* x, const differ::interval_t* y, const clock_t clock)
+	{
+		if(first.found && first.clock <= clock)
+			return;
+		
+		first.found = true;
+		first.process = process;
+		first.clock = clock;
+		first.has_a = x != nullptr;
+		first.has_b = y != nullptr;
+		first.a = x != nullptr ? *x : interval_t();
+		first.b = y != nullptr ? *y : interval_t();
+	}
+	
+	void differ::run()
+	{
+		while(!a.done || !b.done)
+		{
+			step(a);
+			step(b);
+		}
+		
+		for(auto& p : processes)
+			align(p.first, p.second, true);
+	}
+	
+	const differ::divergence_t& differ::divergence() const
+	{
+		return first;
+	}
+	
+	void differ::report(std::ostream& os) const
+	{
+		const auto location = [&os](const bool has, const interval_t& l) {
+			if(has)
+				os << '\t' << l.start << '\t' << l.location;
+			else
+				os << "\t-\t-";
+		};
+		
+		os << "divergence";
+		if(first.found)
+		{
+			os << '\t' << first.process;
+			location(first.has_a, first.a);
+			location(first.has_b, first.b);
+		}
+		else
+			os << "\tnone";
+		os << std::endl;
+		
+		os << "process\tmatched\tonly_a\tonly_b\tstart_delta_mean\tstart_delta_max\tduration_delta_mean\tduration_delta_max" << std::endl;
+		for(const auto& p : processes)
+		{
+			const summary_t& s = p.second.summary;
+			const double matched = s.matched == 0 ? 1.0 : static_cast<double>(s.matched);
+			
+			os
+				<< p.first << '\t' << s.matched << '\t' << s.only_a << '\t' << s.only_b
+				<< '\t' << static_cast<double>(s.start_delta_sum) / matched << '\t' << s.start_delta_max
+				<< '\t' << static_cast<double>(s.duration_delta_sum) / matched << '\t' << s.duration_delta_max
+				<< std::endl;
+		}
+	}
+}
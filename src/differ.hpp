@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "concepts.hpp"
+#include "converter.hpp"
+#include "event_reader.hpp"
+
+namespace uppaal2octopus
+{
+	/* Compares two traces, advancing both parsers a state at a time in
+	 * lockstep. The locations each process goes through are aligned per
+	 * process: equal heads are matched right away, a mismatch is settled
+	 * by the longest common subsequence of the next window of locations on
+	 * both sides, dropping whichever head is not part of it.
+	 *
+	 * Only the locations not aligned yet are kept, at most two windows per
+	 * process and trace; a side running further ahead is settled with the
+	 * window it has. Memory thus depends on the window and the number of
+	 * processes, not on the length of the traces.
+	 */
+	class differ
+	{
+	public:
+		struct interval_t
+		{
+			std::string location;
+			clock_t start, end;
+			
+			interval_t();
+			interval_t(const std::string& location, const clock_t start, const clock_t end);
+		};
+		
+		// The alignment of the locations of a process, with the timing of those in both traces
+		struct summary_t
+		{
+			size_t matched, only_a, only_b;
+			int64_t start_delta_sum, start_delta_max; // Of b relative to a, the largest by magnitude
+			int64_t duration_delta_sum, duration_delta_max;
+			
+			summary_t();
+		};
+		
+		// The earliest location of a process not matched in the other trace
+		struct divergence_t
+		{
+			bool found;
+			std::string process;
+			clock_t clock;
+			bool has_a, has_b; // Whether a trace still had a location of the process there
+			interval_t a, b;
+			
+			divergence_t();
+		};
+	
+	private:
+		struct side_t
+		{
+			event_reader::source_t source;
+			converter c;
+			bool done;
+			
+			side_t(const event_reader::source_t& source, const converter::interval_callback_t& on_interval);
+		};
+		
+		struct process_state_t
+		{
+			std::deque<interval_t> a, b;
+			summary_t summary;
+			
+			process_state_t();
+		};
+		
+		size_t window;
+		side_t a, b;
+		std::map<std::string, process_state_t> processes;
+		divergence_t first;
+		std::vector<uint16_t> lengths; // The table of the last LCS, reused
+		
+		differ(differ&) = delete;
+		void operator=(differ&) = delete;
+		
+		void add(const bool in_a, const location_t& l, const clock_t start, const clock_t end);
+		void step(side_t& s);
+		void align(const std::string& process, process_state_t& p, const bool final);
+		bool skip_a(const process_state_t& p);
+		void diverge(const std::string& process, const interval_t* x, const interval_t* y, const clock_t clock);
+	
+	public:
+		differ(const event_reader::source_t& a, const event_reader::source_t& b, const size_t window = 64);
+		
+		// Compare the traces to their ends.
+		void run();
+		
+		const divergence_t& divergence() const;
+		
+		// The first divergence, then a line per process with its alignment and timing deltas.
+		void report(std::ostream& os) const;
+	};
+}
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <boost/utility/string_ref.hpp>
+
+#include "octopus.hpp"
+
+namespace uppaal2octopus
+{
+	/* Formats of converted events, chosen once as the parameter of an
+	 * event_writer. Formatting an event is then inlined for that format,
+	 * without branching on it per event or per field. Strings are escaped
+	 * by looking up every byte in a table built once per format.
+	 *
+	 * The csv and jsonl formats can add the clocks to the end of every
+	 * interval, as a last field of its end event.
+	 */
+	
+	// The lower bounds of all clocks in the last state of a trace
+	struct clock_values_t
+	{
+		std::vector<std::string> names;
+		std::vector<int> values;
+	};
+	
+	namespace event_format
+	{
+		// The replacement of a byte, if its size is not 0
+		struct escape_t
+		{
+			char text[7];
+			uint8_t size;
+		};
+		
+		struct escape_table_t
+		{
+			escape_t bytes[256];
+		};
+		
+		void inline append_uint(std::string& out, uint32_t x)
+		{
+			char digits[10];
+			char* p = digits + sizeof(digits);
+			
+			do
+			{
+				*--p = static_cast<char>('0' + x % 10);
+				x /= 10;
+			}
+			while(x != 0);
+			
+			out.append(p, digits + sizeof(digits));
+		}
+		
+		void inline append_int(std::string& out, const int x)
+		{
+			if(x < 0)
+				out.push_back('-');
+			
+			append_uint(out, x < 0 ? 0u - static_cast<uint32_t>(x) : static_cast<uint32_t>(x));
+		}
+		
+		void inline append(std::string& out, const boost::string_ref str)
+		{
+			out.append(str.data(), str.size());
+		}
+		
+		void inline append_escaped(std::string& out, const boost::string_ref str, const escape_table_t& table)
+		{
+			size_t run = 0;
+			for(size_t i = 0; i < str.size(); i++)
+			{
+				const escape_t& e = table.bytes[static_cast<unsigned char>(str[i])];
+				if(e.size == 0)
+					continue;
+				
+				out.append(str.data() + run, i - run);
+				out.append(e.text, e.size);
+				run = i + 1;
+			}
+			
+			out.append(str.data() + run, str.size() - run);
+		}
+		
+		// A quote within a quoted field is doubled
+		inline const escape_table_t& csv_escapes()
+		{
+			static const escape_table_t table = [] {
+				escape_table_t t = {};
+				t.bytes['"'] = {"\"\"", 2};
+				return t;
+			}();
+			
+			return table;
+		}
+		
+		// Quotes, backslashes and control characters
+		inline const escape_table_t& json_escapes()
+		{
+			static const escape_table_t table = [] {
+				escape_table_t t = {};
+				for(size_t c = 0; c < 0x20; c++)
+				{
+					static const char hex[] = "0123456789abcdef";
+					t.bytes[c] = {{'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf], 0}, 6};
+				}
+				
+				t.bytes['\n'] = {"\\n", 2};
+				t.bytes['\r'] = {"\\r", 2};
+				t.bytes['\t'] = {"\\t", 2};
+				t.bytes['"'] = {"\\\"", 2};
+				t.bytes['\\'] = {"\\\\", 2};
+				return t;
+			}();
+			
+			return table;
+		}
+	}
+	
+	// The Octopus layout read by ResVis: tab separated, the label quoted but nothing escaped.
+	struct tsv_format
+	{
+		static void header(std::string&, const bool)
+		{}
+		
+		// The layout has no field for clocks
+		static void event(std::string& out, const octopus::event_t& e, const clock_values_t*)
+		{
+			event_format::append(out, e.jobId);
+			out.push_back('\t');
+			event_format::append_uint(out, e.pageNumber);
+			out.push_back('\t');
+			event_format::append(out, e.scenario);
+			out.push_back('\t');
+			event_format::append(out, e.resource);
+			out.push_back('\t');
+			event_format::append_uint(out, e.eventId);
+			out.append(e.startEnd == startend_e::start ? "\tstart\t" : "\tend\t");
+			event_format::append_uint(out, e.timeStamp);
+			out.append("\t\"");
+			event_format::append(out, e.label);
+			out.push_back('"');
+		}
+	};
+	
+	// RFC 4180, with a header and all strings quoted.
+	struct csv_format
+	{
+		static void header(std::string& out, const bool clocks)
+		{
+			out.append(clocks ? "jobId,pageNumber,scenario,resource,eventId,startEnd,timeStamp,label,clocks\n" : "jobId,pageNumber,scenario,resource,eventId,startEnd,timeStamp,label\n");
+		}
+		
+		static void string(std::string& out, const boost::string_ref str)
+		{
+			out.push_back('"');
+			event_format::append_escaped(out, str, event_format::csv_escapes());
+			out.push_back('"');
+		}
+		
+		// Clocks are "<name>=<value>" separated by spaces, empty for start events
+		static void event(std::string& out, const octopus::event_t& e, const clock_values_t* clocks)
+		{
+			string(out, e.jobId);
+			out.push_back(',');
+			event_format::append_uint(out, e.pageNumber);
+			out.push_back(',');
+			string(out, e.scenario);
+			out.push_back(',');
+			string(out, e.resource);
+			out.push_back(',');
+			event_format::append_uint(out, e.eventId);
+			out.append(e.startEnd == startend_e::start ? ",start," : ",end,");
+			event_format::append_uint(out, e.timeStamp);
+			out.push_back(',');
+			string(out, e.label);
+			
+			if(clocks == nullptr)
+				return;
+			
+			out.append(",\"");
+			if(e.startEnd == startend_e::end)
+				for(size_t i = 0; i < clocks->names.size() && i < clocks->values.size(); i++)
+				{
+					if(i > 0)
+						out.push_back(' ');
+					
+					event_format::append_escaped(out, clocks->names[i], event_format::csv_escapes());
+					out.push_back('=');
+					event_format::append_int(out, clocks->values[i]);
+				}
+			out.push_back('"');
+		}
+	};
+	
+	// One JSON object per line, with the fields of octopus::event_t.
+	struct jsonl_format
+	{
+		static void header(std::string&, const bool)
+		{}
+		
+		static void string(std::string& out, const boost::string_ref str)
+		{
+			out.push_back('"');
+			event_format::append_escaped(out, str, event_format::json_escapes());
+			out.push_back('"');
+		}
+		
+		// Clocks are an object of their values by name, only in end events
+		static void event(std::string& out, const octopus::event_t& e, const clock_values_t* clocks)
+		{
+			out.append("{\"jobId\":");
+			string(out, e.jobId);
+			out.append(",\"pageNumber\":");
+			event_format::append_uint(out, e.pageNumber);
+			out.append(",\"scenario\":");
+			string(out, e.scenario);
+			out.append(",\"resource\":");
+			string(out, e.resource);
+			out.append(",\"eventId\":");
+			event_format::append_uint(out, e.eventId);
+			out.append(e.startEnd == startend_e::start ? ",\"startEnd\":\"start\",\"timeStamp\":" : ",\"startEnd\":\"end\",\"timeStamp\":");
+			event_format::append_uint(out, e.timeStamp);
+			out.append(",\"label\":");
+			string(out, e.label);
+			
+			if(clocks != nullptr && e.startEnd == startend_e::end)
+			{
+				out.append(",\"clocks\":{");
+				for(size_t i = 0; i < clocks->names.size() && i < clocks->values.size(); i++)
+				{
+					if(i > 0)
+						out.push_back(',');
+					
+					string(out, clocks->names[i]);
+					out.push_back(':');
+					event_format::append_int(out, clocks->values[i]);
+				}
+				out.push_back('}');
+			}
+			
+			out.push_back('}');
+		}
+	};
+	
+	/* Writes events as lines in the given format. With clocks, end events
+	 * get their values as they are when the event is added.
+	 */
+	template<typename Format>
+	class event_writer
+	{
+		std::ostream& os;
+		const clock_values_t* clocks;
+		std::string line;
+		
+		event_writer(event_writer&) = delete;
+		void operator=(event_writer&) = delete;
+	
+	public:
+		event_writer(std::ostream& os, const clock_values_t* clocks = nullptr)
+		: os(os)
+		, clocks(clocks)
+		, line()
+		{
+			Format::header(line, clocks != nullptr);
+			os.write(line.data(), static_cast<std::streamsize>(line.size()));
+		}
+		
+		void add(const octopus::event_t& e)
+		{
+			line.clear();
+			Format::event(line, e, clocks);
+			line.push_back('\n');
+			os.write(line.data(), static_cast<std::streamsize>(line.size()));
+		}
+	};
+	
+	inline std::ostream& operator<<(std::ostream& o, const octopus::event_t& rhs)
+	{
+		std::string line;
+		tsv_format::event(line, rhs, nullptr);
+		return o << line;
+	}
+}
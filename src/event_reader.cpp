@@ -0,0 +1,64 @@
+#include "event_reader.hpp"
+
+namespace uppaal2octopus
+{
+	event_reader::event_reader(const event_reader::source_t& source)
+	: event_reader(source, "UPPAALtrace", std::make_shared<converter::ids_t>())
+	{}
+	
+	event_reader::event_reader(const event_reader::source_t& source, const std::string& scenario, const std::shared_ptr<converter::ids_t>& ids)
+	: source(source)
+	, c([this](const octopus::event_t& e) {
+		pending.push_back(e);
+	}, scenario, ids)
+	, pending()
+	, exhausted(false)
+	{}
+	
+	bool event_reader::fill()
+	{
+		const location_callback_t f = [this](const location_t& loc, const clock_t clock, const startend_e startEnd) {
+			c.add(loc, clock, startEnd);
+		};
+		
+		while(pending.empty() && !exhausted)
+		{
+			if(!source(f))
+			{
+				c.flush();
+				exhausted = true;
+			}
+		}
+		
+		return !pending.empty();
+	}
+	
+	const octopus::event_t* event_reader::peek()
+	{
+		if(!fill())
+			return nullptr;
+		
+		return &pending.front();
+	}
+	
+	bool event_reader::close_time(clock_t& t)
+	{
+		if(!fill())
+			return false;
+		
+		// The converter passes on the start and end of an interval together
+		const octopus::event_t& e = pending.front().startEnd == startend_e::start ? pending[1] : pending.front();
+		t = e.timeStamp;
+		return true;
+	}
+	
+	bool event_reader::next(octopus::event_t& e)
+	{
+		if(!fill())
+			return false;
+		
+		e = std::move(pending.front());
+		pending.pop_front();
+		return true;
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "concepts.hpp"
+#include "octopus.hpp"
+#include "converter.hpp"
+
+namespace uppaal2octopus
+{
+	/* Pull based conversion of a trace: events are produced on demand,
+	 * by advancing the underlying parser one state at a time. Only the
+	 * events of a single state are buffered, so a consumer can stop early
+	 * or interleave several traces without converting them entirely.
+	 */
+	class event_reader
+	{
+	public:
+		typedef std::function<void(const location_t& loc, const clock_t clock, const startend_e startEnd)> location_callback_t;
+	
+		// Feeds the next state of a trace to the callback; false if the trace has ended.
+		typedef std::function<bool(const location_callback_t&)> source_t;
+	
+	private:
+		source_t source;
+		converter c;
+		std::deque<octopus::event_t> pending;
+		bool exhausted;
+		
+		event_reader(event_reader&) = delete;
+		void operator=(event_reader&) = delete;
+		
+		bool fill();
+	
+	public:
+		event_reader(const source_t& source);
+		event_reader(const source_t& source, const std::string& scenario, const std::shared_ptr<converter::ids_t>& ids);
+		
+		// The next event without consuming it, or nullptr at the end of the trace.
+		const octopus::event_t* peek();
+		
+		// The time the interval of the next event ends, which never decreases over a trace; false at its end.
+		bool close_time(clock_t& t);
+		
+		// Take the next event; false at the end of the trace.
+		bool next(octopus::event_t& e);
+	};
+}
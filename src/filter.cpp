@@ -0,0 +1,75 @@
+#include "filter.hpp"
+
+#include <fnmatch.h>
+
+namespace uppaal2octopus
+{
+	bool inline matches_any(const std::vector<std::string>& globs, const std::string& str)
+	{
+		for(const std::string& glob : globs)
+			if(fnmatch(glob.c_str(), str.c_str(), 0) == 0)
+				return true;
+		
+		return false;
+	}
+
+	filter::filter()
+	: include_processes()
+	, exclude_processes()
+	, include_locations()
+	, exclude_locations()
+	, show_hidden(false)
+	{}
+	
+	void filter::include_process(const std::string& p)
+	{
+		include_processes.insert(p);
+	}
+	
+	void filter::exclude_process(const std::string& p)
+	{
+		exclude_processes.insert(p);
+	}
+	
+	void filter::include_location(const std::string& glob)
+	{
+		include_locations.push_back(glob);
+	}
+	
+	void filter::exclude_location(const std::string& glob)
+	{
+		exclude_locations.push_back(glob);
+	}
+	
+	void filter::set_show_hidden(const bool show)
+	{
+		show_hidden = show;
+	}
+	
+	bool filter::accepts(const std::string& p) const
+	{
+		if(!include_processes.empty() && include_processes.find(p) == include_processes.end())
+			return false;
+		
+		return exclude_processes.find(p) == exclude_processes.end();
+	}
+	
+	bool filter::accepts(const std::string& p, const std::string& l) const
+	{
+		if(!show_hidden && (l.size() < 1 || l[0] == '_'))
+			return false;
+		
+		if(!accepts(p))
+			return false;
+		
+		if(include_locations.empty() && exclude_locations.empty())
+			return true;
+		
+		const std::string name = p + "." + l;
+		
+		if(!include_locations.empty() && !matches_any(include_locations, name))
+			return false;
+		
+		return !matches_any(exclude_locations, name);
+	}
+}
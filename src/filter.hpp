@@ -0,0 +1,34 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+
+namespace uppaal2octopus
+{
+	/* Selects the processes and locations to convert. The parsers resolve
+	 * a filter once per trace, so locations that are filtered out never
+	 * reach the converter.
+	 *
+	 * Location globs are matched against "<process>.<location>". Locations
+	 * without a name or starting with '_' are hidden unless shown explicitly.
+	 */
+	class filter
+	{
+		std::set<std::string> include_processes, exclude_processes;
+		std::vector<std::string> include_locations, exclude_locations;
+		bool show_hidden;
+	
+	public:
+		filter();
+		
+		void include_process(const std::string& p);
+		void exclude_process(const std::string& p);
+		void include_location(const std::string& glob);
+		void exclude_location(const std::string& glob);
+		void set_show_hidden(const bool show);
+		
+		bool accepts(const std::string& p) const;
+		bool accepts(const std::string& p, const std::string& l) const;
+	};
+}
@@ -1,10 +1,11 @@
 #include "hrparser.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <fstream>
 #include <sstream>
 #include <iostream>
 #include <stdexcept>
-#include <boost/regex.hpp>
-#include <boost/lexical_cast.hpp>
 
 namespace uppaal2octopus
 {
@@ -13,18 +14,43 @@ namespace uppaal2octopus
 		throw std::runtime_error("Failed to parse trace");
 	}
 	
-	std::pair<std::string, std::string> inline split(const std::string& str)
+	// The position of the last '.' separating "<process>.<location>", both non-empty
+	size_t inline split(const std::string& str)
 	{
-		const static boost::regex r("(.+)\\.(.+)");
-		boost::smatch m;
+		if(str.size() < 3)
+			error();
+		
+		const size_t dot = str.rfind('.', str.size() - 2);
+		if(dot == std::string::npos || dot == 0)
+			error();
+		
+		return dot;
+	}
+	
+	// A number of the given type, covering all of str
+	template<typename T>
+	T inline to_number(const char* str, const char* end)
+	{
+		const bool negative = str != end && *str == '-';
+		if(negative)
+			str++;
 		
-		if(!boost::regex_match(str, m, r))
+		if(str == end)
 			error();
 		
-		return std::make_pair(m[1], m[2]);
+		T x = 0;
+		for(; str != end; str++)
+		{
+			if(*str < '0' || *str > '9')
+				error();
+			
+			x = x * 10 + static_cast<T>(*str - '0');
+		}
+		
+		return negative ? -x : x;
 	}
 
-	bool hrparser::match(const std::string x)
+	bool hrparser::match(const char* x)
 	{
 		if(x == buffer)
 		{
@@ -43,77 +69,201 @@ namespace uppaal2octopus
 	
 	bool hrparser::try_consume()
 	{
-		return is >> buffer;
+		return scanner.next(buffer);
+	}
+	
+	void hrparser::skip_until(const char close)
+	{
+		// Walk the index for the token consisting of close only, without copying what precedes it
+		if(!scanner.skip_until(close))
+			error();
+	}
+
+	const hrparser::resolved_t& hrparser::resolve(const std::string& token)
+	{
+		const auto l_i = locations.find(token);
+		if(l_i != locations.end())
+			return l_i->second;
+		
+		const size_t dot = split(token);
+		
+		const auto p_i = processes.emplace(token.substr(0, dot), processes.size()).first;
+		if(p_i->second == current.size())
+			current.push_back(nullptr);
+		
+		// The names refer to the cached token, which stays in place
+		const auto r_i = locations.emplace(token, resolved_t{boost::none, p_i->second}).first;
+		const std::string& key = r_i->first;
+		
+		if(selection.accepts(key.substr(0, dot), key.substr(dot + 1)))
+			r_i->second.location = location_t(location_t::first_type(key.data(), dot), location_t::second_type(key.data() + dot + 1, key.size() - dot - 1));
+		
+		return r_i->second;
 	}
 
-	hrparser::state_t hrparser::read_state()
+	size_t hrparser::clock_id(const char* begin, const char* end)
+	{
+		key.assign(begin, end);
+		
+		const auto c_i = clock_ids.find(key);
+		if(c_i != clock_ids.end())
+			return c_i->second;
+		
+		if(started)
+			return 0;
+		
+		clock_names.push_back(key);
+		return clock_ids.emplace(key, clock_names.size()).first->second;
+	}
+	
+	void hrparser::add_bound(const char* str, const char* minus, const char* op, const char* end)
+	{
+		const size_t i = clock_id(str, minus);
+		const size_t j = minus == op ? 0 : clock_id(minus + 1, op);
+		if(i == 0 || (j == 0 && minus != op))
+			return;
+		
+		// A lower bound i - j >= value is the bound j - i <= -value
+		const int value = to_number<int>(op + 2, end);
+		if(*op == '>')
+			bounds.push_back({j, i, -value});
+		else
+			bounds.push_back({i, j, value});
+	}
+	
+	void hrparser::read_clocks(const clock_t clock)
+	{
+		if(!started)
+			clock_bounds = dbm(clock_names.size() + 1);
+		
+		clock_bounds.clear();
+		
+		// Clocks are not negative, later bounds on the same pair replace earlier ones
+		for(size_t i = 1; i <= clock_names.size(); i++)
+			clock_bounds.set(0, i, 0);
+		for(const bound_t& b : bounds)
+			clock_bounds.set(b.i, b.j, b.value);
+		
+		bounds.clear();
+		
+		clock_bounds.lower_bounds(0, lower_bounds);
+		clock_values.assign(lower_bounds.begin() + 1, lower_bounds.end());
+		
+		on_clocks(clock, clock_names, clock_values);
+	}
+
+	clock_t hrparser::read_state()
 	{	
-		state_t s;
+		clock_t clock = 0;
 		
-		if(!match("State") || !match("("))
+		if(!match("State") || buffer != "(")
 			error();
-			
-		while(buffer != ")")
+		
+		if(!started)
 		{
-			s.locations.emplace_back(split(buffer));
 			consume();
+			while(buffer != ")")
+			{
+				const resolved_t& r = resolve(buffer);
+				current[r.process] = &r;
+				consume();
+			}
 		}
+		else if(validate)
+		{
+			consume();
+			size_t count = 0;
+			for(; buffer != ")"; count++)
+			{
+				const auto l_i = locations.find(buffer);
+				if(l_i == locations.end() || current[l_i->second.process] != &l_i->second)
+					throw std::runtime_error("State does not match the transitions before it at " + buffer);
+				
+				consume();
+			}
+			
+			if(count != current.size())
+				throw std::runtime_error("State does not list all processes");
+		}
+		else
+			skip_until(')'); // Known from the transitions
 
 		bool found_lower_clock = false, found_upper_clock = false;
+		size_t variable_i = 0;
 		while(try_consume() && buffer != "Transitions:")
 		{
 			if(buffer.size() > 0 && buffer[buffer.size()-1] == ',')
 				buffer.pop_back(); //Remove superfluous comma
-		
-			const static boost::regex r_clock("^([^-]+)([><]=)(.+)$");
-			const static boost::regex r_dbm("^(.+)-(.+)([><]=)(.+)$");
-			const static boost::regex r_var("^(.+)=(.+)$");
 			
-			boost::smatch m;
-			if(boost::regex_match(buffer, m, r_clock))
+			/* A token is either a clock bound "<clock><op><value>", a bound
+			 * on a difference "<clock>-<clock><op><value>" or a variable
+			 * "<name>=<value>", where op is >= or <=.
+			 */
+			const char* str = buffer.data();
+			const char* end = str + buffer.size();
+			
+			const char* op = str + 1;
+			while(op + 1 < end && !((*op == '>' || *op == '<') && op[1] == '='))
+				op++;
+			
+			if(op + 2 < end)
 			{
-				if(m[1] == "c" && m[2] == ">=") // Take the lower bound, has precedence
-				{
-					s.clock = boost::lexical_cast<size_t>(m[3]);
-					found_lower_clock = true;
-				}
-				else if(!found_lower_clock && m[1] == "c" && m[2] == "<=")
+				const char* minus = std::find(str, op, '-');
+				if(on_clocks)
+					add_bound(str, minus, op, end);
+				
+				if(minus != op)
+					continue; // A difference, not needed for c
+				
+				const bool lower = *op == '>';
+				if(op - str == 1 && *str == 'c' && (lower || !found_lower_clock)) // Take the lower bound, has precedence
 				{
-					s.clock = boost::lexical_cast<size_t>(m[3]);
-					found_upper_clock = true;
+					clock = static_cast<clock_t>(to_number<size_t>(op + 2, end));
+					(lower ? found_lower_clock : found_upper_clock) = true;
 				}
+				
+				continue;
 			}
-			else if(boost::regex_match(buffer, m, r_dbm))
-				; // Do nothing
-			else if(boost::regex_match(buffer, m, r_var))
-				; // Do nothing
-			else
+			
+			const char* eq = std::find(str + 1, end, '=');
+			if(eq + 1 >= end)
 				error();
+			
+			if(!on_state)
+				continue;
+			
+			// The first state determines the variables, later states list them in the same order
+			if(!started && variable_i == variable_names.size())
+			{
+				variable_names.emplace_back(str, eq);
+				variable_values.push_back(0);
+			}
+			else if(variable_i >= variable_names.size() || variable_names[variable_i].compare(0, std::string::npos, str, static_cast<size_t>(eq - str)) != 0)
+				throw std::runtime_error("Inconsistent variables in State");
+			
+			variable_values[variable_i++] = to_number<int>(eq + 1, end);
 		}
 		
 		if(!found_lower_clock && !found_upper_clock)
 			throw std::runtime_error("Cannot find clock 'c' in State");
 		
-		return s;
-	}
-	
-	void process_transition_meta(const std::string /*str*/, const size_t /*i*/)
-	{
-		/* Do nothing with transition meta information
-		if(i == 0 && str != "1")
-			std::cout << "[GUARD] " << str << std::endl;
-		else if(i == 1 && str != "tau")
-			std::cout << "[SYNC] " << str << std::endl;
-		else if(i >= 2 && str != "1")
-			std::cout << "[UPDATE] " << str << std::endl;
-		*/
+		if(on_state)
+		{
+			if(variable_i != variable_names.size())
+				throw std::runtime_error("Inconsistent variables in State");
+			
+			on_state(clock, variable_names, variable_values);
+		}
 		
-		return;
+		if(on_clocks)
+			read_clocks(clock);
+		
+		return clock;
 	}
 	
-	std::vector<hrparser::transition_t> hrparser::read_transition()
+	hrparser::transitions_t hrparser::read_transition()
 	{
-		std::vector<transition_t> result;
+		transitions_t result{arena_allocator<transition_t>(state_memory)};
 	
 		if(!match("Transitions:"))
 			error();
@@ -121,24 +271,36 @@ namespace uppaal2octopus
 		do
 		{
 			{
-				const static boost::regex r("(.+)->(.+)");
-				boost::smatch m;
-			
-				if(!boost::regex_match(buffer, m, r))
+				const size_t arrow = buffer.rfind("->");
+				if(arrow == std::string::npos || arrow == 0 || arrow + 2 == buffer.size())
 					error();
 			
-				const auto s1 = split(m[1]);
-				const auto s2 = split(m[2]);
-			
-				result.push_back({s1, s2});
+				key.assign(buffer, 0, arrow);
+				const resolved_t& from = resolve(key);
+				key.assign(buffer, arrow + 2, std::string::npos);
+				result.push_back({&from, &resolve(key)});
 			}
 			
+			const bool record = on_transition && (result.back().from->location || result.back().to->location);
+			if(record)
+				edges.push_back({buffer});
+			
 			consume();
-			if(!match("{"))
+			if(buffer != "{")
 				error();
 			
+			if(!record)
 			{
-				size_t i = 0; // 0 = guard, 1 = synchronizations, 2.. = updates
+				// The metadata is not used, skip it
+				skip_until('}');
+				consume();
+				continue;
+			}
+			
+			consume();
+			
+			{
+				std::vector<std::string>& meta = edges.back(); // Followed by the guard, synchronizations and updates
 				std::string str;
 				
 				while(!match("}")) //A block ends with either a string with ',' at the end, or the string "}"
@@ -152,7 +314,7 @@ namespace uppaal2octopus
 						str.pop_back(); //Remove superfluous space
 						str.pop_back(); //Remove superfluous comma
 						
-						process_transition_meta(str, i++);
+						meta.push_back(str);
 						str.clear();
 					}
 				}
@@ -160,7 +322,7 @@ namespace uppaal2octopus
 				if(str.size() > 0)
 					str.pop_back(); //Remove superfluous space
 				
-				process_transition_meta(str, i++);
+				meta.push_back(str);
 			}
 			
 		} while(buffer != "State");
@@ -168,27 +330,85 @@ namespace uppaal2octopus
 		return result;
 	}
 
-	void hrparser::parse(const std::string file, const hrparser::callback_t& f)
+	void hrparser::parse(const std::string file, const hrparser::callback_t& f, const filter& selection, const hrparser::state_callback_t& on_state, const hrparser::transition_callback_t& on_transition, const bool validate, const hrparser::clocks_callback_t& on_clocks)
 	{
-		hrparser p(file);
-		p.consume();
+		std::ifstream is(file);
+		parse(is, f, selection, on_state, on_transition, validate, on_clocks);
+	}
+	
+	bool hrparser::next(const hrparser::callback_t& f)
+	{
+		// Nothing parsed from the previous state is referred to anymore
+		state_memory.reset();
 		
+		if(!started)
 		{
-			const state_t s = p.read_state();
-			for(const auto loc : s.locations)
-				f(loc, s.clock, startend_e::start);
+			consume();
+			
+			const clock_t clock = read_state();
+			for(const resolved_t* r : current)
+				if(r && r->location)
+					f(r->location.get(), clock, startend_e::start);
+			
+			last = clock;
+			started = true;
+			return true;
 		}
 		
-		while(p.buffer == "Transitions:")
+		if(buffer != "Transitions:")
 		{
-			const std::vector<transition_t> ts = p.read_transition();
-			const state_t s = p.read_state();
+			// End of the trace, also when the last transitions were filtered out
+			std::vector<const location_t*, arena_allocator<const location_t*>> open{arena_allocator<const location_t*>(state_memory)};
+			for(const resolved_t* r : current)
+				if(r && r->location)
+					open.push_back(&r->location.get());
 			
-			for(const transition_t t : ts)
-			{
-				f(t.from, s.clock, startend_e::end);
-				f(t.to, s.clock, startend_e::start);
-			}
+			std::sort(open.begin(), open.end(), [](const location_t* x, const location_t* y) {
+				return x->first < y->first;
+			});
+			
+			for(const location_t* l : open)
+				f(*l, last, startend_e::end);
+			
+			current.assign(current.size(), nullptr);
+			return false;
 		}
+		
+		const transitions_t ts = read_transition();
+		
+		// Apply the transitions before reading the state, which is validated against them
+		for(const transition_t& t : ts)
+		{
+			if(validate && (current[t.from->process] != t.from || t.to->process != t.from->process))
+				throw std::runtime_error("Transition does not start at the location of its process");
+			
+			current[t.to->process] = t.to;
+		}
+		
+		const clock_t clock = read_state();
+		
+		if(on_transition && !edges.empty())
+		{
+			on_transition(clock, edges);
+			edges.clear();
+		}
+		
+		for(const transition_t& t : ts)
+		{
+			if(t.from->location)
+				f(t.from->location.get(), clock, startend_e::end);
+			
+			if(t.to->location)
+				f(t.to->location.get(), clock, startend_e::start);
+		}
+		
+		last = clock;
+		return true;
+	}
+
+	void hrparser::parse(std::istream& is, const hrparser::callback_t& f, const filter& selection, const hrparser::state_callback_t& on_state, const hrparser::transition_callback_t& on_transition, const bool validate, const hrparser::clocks_callback_t& on_clocks)
+	{
+		hrparser p(is, selection, on_state, on_transition, validate, on_clocks);
+		while(p.next(f));
 	}
 }
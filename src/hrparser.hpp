@@ -1,50 +1,144 @@
 #pragma once
 
-#include <fstream>
+#include <istream>
 #include <functional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include <boost/optional.hpp>
+
+#include "arena.hpp"
 #include "concepts.hpp"
+#include "dbm.hpp"
+#include "filter.hpp"
+#include "hrscanner.hpp"
 
 namespace uppaal2octopus
 {
 	class hrparser
 	{
 	public:
-		typedef std::function<void(const location_t loc, const clock_t clock, const startend_e startEnd)> callback_t;
+		typedef std::function<void(const location_t& loc, const clock_t clock, const startend_e startEnd)> callback_t;
+		typedef std::function<void(const clock_t clock, const std::vector<std::string>& names, const std::vector<int>& values)> state_callback_t;
+		typedef state_callback_t clocks_callback_t;
+		
+		// The edges of a transition, each as its "<from>-><to>" followed by its guard, synchronisation and updates
+		typedef std::function<void(const clock_t clock, const std::vector<std::vector<std::string>>& edges)> transition_callback_t;
 	
 	private:
-		struct state_t
+		// A "<process>.<location>" token; locations that are filtered out are none
+		struct resolved_t
 		{
-			std::vector<location_t> locations;
-			clock_t clock;
+			boost::optional<location_t> location;
+			size_t process;
 		};
 		
 		struct transition_t
 		{
-			location_t from, to;
+			const resolved_t* from;
+			const resolved_t* to;
+		};
+		
+		// A bound i - j <= value on clocks by id
+		struct bound_t
+		{
+			size_t i, j;
+			int value;
 		};
+		
+		typedef std::vector<transition_t, arena_allocator<transition_t>> transitions_t;
 	
-		std::ifstream is;
+		hrscanner scanner;
 		std::string buffer;
+		std::string key; // The location token being resolved, reused
+		bool started;
 		
-		hrparser(const std::string file)
-		: is(file)
-		, buffer()
-		{}
+		arena state_memory; // Objects parsed from the current state, released when the next one is read
+		
+		const filter selection;
+		std::unordered_map<std::string, resolved_t> locations; // Resolved "<process>.<location>" tokens
+		std::unordered_map<std::string, size_t> processes; // Process ids, in the order of the first state
+		
+		/* The location of every process by id, taken from the first state and
+		 * updated by the transitions only. Thus later states need not be read,
+		 * unless validating. The locations are closed at the clock of the last state.
+		 */
+		std::vector<const resolved_t*> current;
+		clock_t last;
+		bool validate;
+		
+		// Variable values of the current state, only read when requested
+		state_callback_t on_state;
+		std::vector<std::string> variable_names;
+		std::vector<int> variable_values;
+		
+		/* Lower bounds of the clocks of the current state, only computed when
+		 * requested. The clocks are those of the first state, by id from 1;
+		 * 0 is the reference clock the bounds are relative to.
+		 */
+		clocks_callback_t on_clocks;
+		std::unordered_map<std::string, size_t> clock_ids;
+		std::vector<std::string> clock_names;
+		std::vector<bound_t> bounds;
+		dbm clock_bounds;
+		std::vector<int> lower_bounds;
+		std::vector<int> clock_values;
+		
+		// Edges of the current transition with their metadata, only read when requested
+		transition_callback_t on_transition;
+		std::vector<std::vector<std::string>> edges;
 		
 		hrparser(hrparser&) = delete;
 		void operator=(hrparser&) = delete;
 		
-		bool match(const std::string x);
+		bool match(const char* x);
 		void consume();
 		bool try_consume();
+		void skip_until(const char close);
+		
+		const resolved_t& resolve(const std::string& token);
+		
+		// The id of a clock, 0 for the reference or if it is not one of the first state
+		size_t clock_id(const char* begin, const char* end);
+		void add_bound(const char* str, const char* minus, const char* op, const char* end);
+		void read_clocks(const clock_t clock);
 		
-		state_t read_state();
-		std::vector<transition_t> read_transition();
+		clock_t read_state();
+		transitions_t read_transition();
 		
 	public:
-		static void parse(const std::string file, const callback_t& f);
+		// When validating, every state is checked against the locations reached by the transitions.
+		hrparser(std::istream& is, const filter& selection = filter(), const state_callback_t& on_state = nullptr, const transition_callback_t& on_transition = nullptr, const bool validate = false, const clocks_callback_t& on_clocks = nullptr)
+		: scanner(is)
+		, buffer()
+		, key()
+		, started(false)
+		, state_memory()
+		, selection(selection)
+		, locations()
+		, processes()
+		, current()
+		, last(0)
+		, validate(validate)
+		, on_state(on_state)
+		, variable_names()
+		, variable_values()
+		, on_clocks(on_clocks)
+		, clock_ids()
+		, clock_names()
+		, bounds()
+		, clock_bounds(0)
+		, lower_bounds()
+		, clock_values()
+		, on_transition(on_transition)
+		, edges()
+		{}
+		
+		// Parse the next state of the trace; false if the trace has ended.
+		bool next(const callback_t& f);
+		
+		static void parse(const std::string file, const callback_t& f, const filter& selection = filter(), const state_callback_t& on_state = nullptr, const transition_callback_t& on_transition = nullptr, const bool validate = false, const clocks_callback_t& on_clocks = nullptr);
+		static void parse(std::istream& is, const callback_t& f, const filter& selection = filter(), const state_callback_t& on_state = nullptr, const transition_callback_t& on_transition = nullptr, const bool validate = false, const clocks_callback_t& on_clocks = nullptr);
 	};
 }
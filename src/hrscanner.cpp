@@ -0,0 +1,215 @@
+#include "hrscanner.hpp"
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HRSCANNER_X86
+#include <immintrin.h>
+#endif
+
+namespace uppaal2octopus
+{
+	// A mask of the whitespace among 64 bytes, bit i for byte i
+	typedef uint64_t (*classifier_t)(const char* block);
+	
+	bool inline is_hr_space(const char c)
+	{
+		return c == ' ' || static_cast<unsigned char>(c - '\t') < 5; // \t, \n, \v, \f and \r
+	}
+	
+	uint64_t whitespace_scalar(const char* block)
+	{
+		uint64_t mask = 0;
+		for(size_t i = 0; i < 64; i++)
+			mask |= static_cast<uint64_t>(is_hr_space(block[i])) << i;
+		
+		return mask;
+	}
+
+#ifdef HRSCANNER_X86
+	/* Besides ' ', the whitespace is the range \t to \r. Adding 0x77 maps
+	 * that range to the five smallest signed bytes, and all others above.
+	 */
+	__attribute__((target("sse2"))) uint64_t whitespace_sse2(const char* block)
+	{
+		const __m128i space = _mm_set1_epi8(' '), shift = _mm_set1_epi8(0x77), limit = _mm_set1_epi8(-123);
+		uint64_t mask = 0;
+		
+		for(size_t i = 0; i < 4; i++)
+		{
+			const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+			const __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(x, space), _mm_cmplt_epi8(_mm_add_epi8(x, shift), limit));
+			mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(ws))) << (16 * i);
+		}
+		
+		return mask;
+	}
+	
+	__attribute__((target("avx2"))) uint64_t whitespace_avx2(const char* block)
+	{
+		const __m256i space = _mm256_set1_epi8(' '), shift = _mm256_set1_epi8(0x77), limit = _mm256_set1_epi8(-123);
+		uint64_t mask = 0;
+		
+		for(size_t i = 0; i < 2; i++)
+		{
+			const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32 * i));
+			const __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(x, space), _mm256_cmpgt_epi8(limit, _mm256_add_epi8(x, shift)));
+			mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(ws))) << (32 * i);
+		}
+		
+		return mask;
+	}
+#endif
+	
+	struct isa_t
+	{
+		const char* name;
+		classifier_t classify;
+	};
+	
+	isa_t inline select_isa()
+	{
+#ifdef HRSCANNER_X86
+		__builtin_cpu_init();
+		
+		if(__builtin_cpu_supports("avx2"))
+			return {"avx2", whitespace_avx2};
+		
+		if(__builtin_cpu_supports("sse2"))
+			return {"sse2", whitespace_sse2};
+#endif
+		return {"scalar", whitespace_scalar};
+	}
+	
+	static const isa_t selected_isa = select_isa();
+	
+	hrscanner::hrscanner(std::istream& is)
+	: is(is)
+	, buffer(1 << 18)
+	, size(0)
+	, tail(0)
+	, eof(false)
+	, bounds()
+	, bound_count(0)
+	, next_bound(0)
+	{}
+	
+	const char* hrscanner::isa()
+	{
+		return selected_isa.name;
+	}
+	
+	bool hrscanner::fill()
+	{
+		while(next_bound == bound_count)
+		{
+			if(eof)
+				return false;
+			
+			// Move the token cut off at the end of the last chunk to the front
+			const size_t kept = size - tail;
+			memmove(buffer.data(), buffer.data() + tail, kept);
+			
+			if(kept == buffer.size())
+			{
+				buffer.resize(buffer.size() * 2);
+				bounds.reset();
+			}
+			
+			is.read(buffer.data() + kept, static_cast<std::streamsize>(buffer.size() - kept));
+			const size_t read = static_cast<size_t>(is.gcount());
+			
+			size = kept + read;
+			eof = read < buffer.size() - kept;
+			
+			index();
+		}
+		
+		return true;
+	}
+	
+	void hrscanner::index()
+	{
+		// Every byte can be a bound, plus the end of a token at the end of the buffer
+		if(!bounds)
+			bounds.reset(new uint32_t[buffer.size() + 1]);
+		
+		uint32_t* out = bounds.get();
+		
+		uint64_t carry = 1; // Whether the byte before the block is whitespace
+		const auto emit = [&](const uint64_t ws, const uint32_t offset) {
+			// Bounds are where whitespace starts or stops, alternating between token starts and ends
+			for(uint64_t changes = ws ^ ((ws << 1) | carry); changes != 0; changes &= changes - 1)
+				*out++ = offset + static_cast<uint32_t>(__builtin_ctzll(changes));
+			
+			carry = ws >> 63;
+		};
+		
+		size_t i = 0;
+		for(; i + 64 <= size; i += 64)
+			emit(selected_isa.classify(buffer.data() + i), static_cast<uint32_t>(i));
+		
+		if(i < size)
+		{
+			// The last bytes, padded with whitespace
+			char block[64];
+			memset(block, ' ', sizeof(block));
+			memcpy(block, buffer.data() + i, size - i);
+			emit(selected_isa.classify(block), static_cast<uint32_t>(i));
+		}
+		
+		// Without padding, a token running up to the end of the buffer has not been ended
+		if((out - bounds.get()) % 2 != 0)
+			*out++ = static_cast<uint32_t>(size);
+		
+		bound_count = static_cast<size_t>(out - bounds.get());
+		next_bound = 0;
+		
+		// A token running up to the end of the buffer may continue in the next chunk
+		if(!eof && bound_count > 0 && bounds[bound_count - 1] == size)
+		{
+			tail = bounds[bound_count - 2];
+			bound_count -= 2;
+		}
+		else
+			tail = size;
+	}
+	
+	bool hrscanner::next(const char*& token, size_t& length)
+	{
+		if(!fill())
+			return false;
+		
+		token = buffer.data() + bounds[next_bound];
+		length = bounds[next_bound + 1] - bounds[next_bound];
+		next_bound += 2;
+		
+		return true;
+	}
+	
+	bool hrscanner::next(std::string& token)
+	{
+		const char* data;
+		size_t length;
+		
+		if(!next(data, length))
+			return false;
+		
+		token.assign(data, length);
+		return true;
+	}
+	
+	bool hrscanner::skip_until(const char c)
+	{
+		while(fill())
+		{
+			const uint32_t start = bounds[next_bound], end = bounds[next_bound + 1];
+			next_bound += 2;
+			
+			if(end - start == 1 && buffer[start] == c)
+				return true;
+		}
+		
+		return false;
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace uppaal2octopus
+{
+	/* Splits an hr trace into whitespace separated tokens, like reading
+	 * it with operator>>, in two stages over chunks of the stream.
+	 *
+	 * The first stage builds a structural index of a chunk: the offsets at
+	 * which tokens start and end. It classifies 64 bytes at a time as
+	 * whitespace or not with SSE2 or AVX2, chosen at runtime, or with
+	 * scalar code on other machines. All structure of the hr format, from
+	 * "State" and "Transitions:" to braces and "->" edges, is in tokens of
+	 * their own or inside them, so boundaries are all stage one needs.
+	 *
+	 * The second stage, the parser, walks the index; skipping tokens thus
+	 * costs nothing but a comparison of their first bytes.
+	 */
+	class hrscanner
+	{
+		std::istream& is;
+		std::vector<char> buffer;
+		size_t size;
+		size_t tail; // The start of a token cut off at the end of the buffer, or size
+		bool eof;
+		
+		// The start and end of every token in the buffer, allocated for the worst case but only touched as far as used
+		std::unique_ptr<uint32_t[]> bounds;
+		size_t bound_count, next_bound;
+		
+		hrscanner(hrscanner&) = delete;
+		void operator=(hrscanner&) = delete;
+		
+		bool fill();
+		void index();
+	
+	public:
+		hrscanner(std::istream& is);
+		
+		// The next token, which refers to the buffer until the next call; false at the end of the stream.
+		bool next(const char*& token, size_t& length);
+		bool next(std::string& token);
+		
+		// Skip up to and including the token consisting of c only; false if there is none.
+		bool skip_until(const char c);
+		
+		// The instruction set classifying bytes: "avx2", "sse2" or "scalar".
+		static const char* isa();
+	};
+}
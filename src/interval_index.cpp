@@ -0,0 +1,359 @@
+#include "interval_index.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+
+namespace uppaal2octopus
+{
+	template<typename T>
+	void inline write_items(FILE* file, const T* items, const size_t count)
+	{
+		if(count > 0 && fwrite(items, sizeof(T), count, file) != count)
+			throw std::runtime_error("Failed to write index");
+	}
+	
+	void inline read_interval(FILE* file, interval_index::interval_t& i)
+	{
+		if(fread(&i, sizeof(i), 1, file) != 1)
+			throw std::runtime_error("Failed to read spilled intervals");
+	}
+	
+	index_writer::index_writer(const size_t budget)
+	: budget(budget)
+	, used(0)
+	, string_ids()
+	, strings()
+	, key()
+	, resources()
+	, buffered()
+	, runs()
+	, open()
+	{}
+	
+	index_writer::~index_writer()
+	{
+		for(const run_t& run : runs)
+			fclose(run.file);
+	}
+	
+	uint32_t index_writer::string_id(const boost::string_ref str)
+	{
+		key.assign(str.data(), str.size());
+		
+		const auto i = string_ids.find(key);
+		if(i != string_ids.end())
+			return i->second;
+		
+		const auto j = string_ids.emplace(key, static_cast<uint32_t>(strings.size())).first;
+		strings.push_back(&j->first);
+		return j->second;
+	}
+	
+	void index_writer::add(const octopus::event_t& e)
+	{
+		// The strings of the event are gone once it is passed on, only their ids are kept
+		if(e.startEnd == startend_e::start)
+		{
+			const uint32_t resource = string_id(e.resource);
+			const interval_index::interval_t i = {
+				e.timeStamp,
+				0,
+				e.eventId,
+				e.pageNumber,
+				string_id(e.label),
+				string_id(e.scenario)
+			};
+			open.insert(std::make_pair(e.eventId, std::make_pair(resource, i)));
+			return;
+		}
+		
+		const auto s_i = open.find(e.eventId);
+		if(s_i == open.end())
+			throw std::runtime_error("Received end-event without a corresponding start event");
+		
+		const uint32_t resource = s_i->second.first;
+		interval_index::interval_t& i = s_i->second.second;
+		i.end = e.timeStamp;
+		
+		resources[*strings[resource]]++;
+		buffered[resource].push_back(i);
+		
+		open.erase(s_i);
+		
+		used += sizeof(interval_index::interval_t);
+		if(used > budget)
+			spill();
+	}
+	
+	void index_writer::sort()
+	{
+		for(auto& r : buffered)
+			std::sort(r.second.begin(), r.second.end(), [](const interval_index::interval_t& x, const interval_index::interval_t& y) {
+				return x.start < y.start;
+			});
+	}
+	
+	void index_writer::spill()
+	{
+		sort();
+		
+		FILE* file = tmpfile();
+		if(file == NULL)
+			throw std::runtime_error("Cannot create temporary file for the index");
+		
+		runs.push_back({file, {}});
+		run_t& run = runs.back();
+		
+		uint64_t offset = 0;
+		for(const auto& r : buffered)
+		{
+			write_items(file, r.second.data(), r.second.size());
+			run.sections[r.first] = {offset, r.second.size()};
+			offset += r.second.size();
+		}
+		
+		if(fflush(file) != 0)
+			throw std::runtime_error("Failed to write spilled intervals");
+		
+		buffered.clear();
+		used = 0;
+	}
+	
+	void index_writer::merge(const uint32_t resource, const std::function<void(const interval_index::interval_t&)>& f)
+	{
+		using namespace interval_index;
+		typedef std::pair<uint32_t, size_t> head_t; // start, run; the buffered intervals are last
+		
+		std::vector<interval_t> heads(runs.size());
+		std::vector<uint64_t> left(runs.size(), 0);
+		std::priority_queue<head_t, std::vector<head_t>, std::greater<head_t>> q;
+		
+		for(size_t i = 0; i < runs.size(); i++)
+		{
+			const auto s_i = runs[i].sections.find(resource);
+			if(s_i == runs[i].sections.end())
+				continue;
+			
+			if(fseek(runs[i].file, static_cast<long>(s_i->second.offset * sizeof(interval_t)), SEEK_SET) != 0)
+				throw std::runtime_error("Failed to read spilled intervals");
+			
+			read_interval(runs[i].file, heads[i]);
+			left[i] = s_i->second.count - 1;
+			q.emplace(heads[i].start, i);
+		}
+		
+		const auto b_i = buffered.find(resource);
+		const std::vector<interval_t>* rest = b_i != buffered.end() ? &b_i->second : nullptr;
+		size_t next_buffered = 0;
+		
+		if(rest != nullptr && !rest->empty())
+			q.emplace((*rest)[0].start, runs.size());
+		
+		while(!q.empty())
+		{
+			const size_t i = q.top().second;
+			q.pop();
+			
+			if(i == runs.size())
+			{
+				f((*rest)[next_buffered++]);
+				
+				if(next_buffered < rest->size())
+					q.emplace((*rest)[next_buffered].start, i);
+			}
+			else
+			{
+				f(heads[i]);
+				
+				if(left[i] > 0)
+				{
+					read_interval(runs[i].file, heads[i]);
+					left[i]--;
+					q.emplace(heads[i].start, i);
+				}
+			}
+		}
+	}
+	
+	void index_writer::write(const std::string& path)
+	{
+		using namespace interval_index;
+		
+		sort();
+		
+		// All sizes are known up front; the blocks are filled in while the intervals are written
+		std::vector<resource_t> rs;
+		uint64_t block_count = 0, interval_count = 0;
+		for(const auto& r : resources)
+		{
+			const uint64_t blocks = (r.second + block_size - 1) / block_size;
+			rs.push_back({string_id(r.first), block_count, blocks});
+			
+			block_count += blocks;
+			interval_count += r.second;
+		}
+		
+		header_t h;
+		memcpy(h.magic, magic, sizeof(magic));
+		h.resource_count = rs.size();
+		h.block_count = block_count;
+		h.interval_count = interval_count;
+		h.string_count = strings.size();
+		
+		std::unique_ptr<FILE, int(*)(FILE*)> file(fopen(path.c_str(), "wb"), fclose);
+		if(!file)
+			throw std::runtime_error(std::string("Cannot open index ") + path);
+		
+		write_items(file.get(), &h, 1);
+		write_items(file.get(), rs.data(), rs.size());
+		
+		const long blocks_offset = ftell(file.get());
+		if(blocks_offset < 0 || fseek(file.get(), static_cast<long>(blocks_offset + block_count * sizeof(block_t)), SEEK_SET) != 0)
+			throw std::runtime_error("Failed to write index");
+		
+		std::vector<block_t> bs;
+		std::vector<interval_t> block;
+		uint64_t written = 0;
+		
+		for(const resource_t& r : rs)
+		{
+			uint32_t max_end = 0;
+			const auto write_block = [&]() {
+				for(const interval_t& i : block)
+					max_end = std::max(max_end, i.end);
+				
+				bs.push_back({block.front().start, max_end, written, block.size()});
+				write_items(file.get(), block.data(), block.size());
+				
+				written += block.size();
+				block.clear();
+			};
+			
+			merge(static_cast<uint32_t>(r.name), [&](const interval_t& i) {
+				block.push_back(i);
+				if(block.size() == block_size)
+					write_block();
+			});
+			
+			if(!block.empty())
+				write_block();
+		}
+		
+		uint64_t offset = 0;
+		for(const std::string* str : strings)
+		{
+			const string_t s = {offset, str->size()};
+			write_items(file.get(), &s, 1);
+			offset += str->size();
+		}
+		
+		for(const std::string* str : strings)
+			write_items(file.get(), str->data(), str->size());
+		
+		if(fseek(file.get(), blocks_offset, SEEK_SET) != 0)
+			throw std::runtime_error("Failed to write index");
+		
+		write_items(file.get(), bs.data(), bs.size());
+		
+		if(fflush(file.get()) != 0)
+			throw std::runtime_error("Failed to write index");
+	}
+	
+	index_reader::index_reader(const std::string& path)
+	: file()
+	, header(nullptr)
+	, resources(nullptr)
+	, blocks(nullptr)
+	, intervals(nullptr)
+	, strings(nullptr)
+	, string_data(nullptr)
+	, string_data_size(0)
+	{
+		using namespace interval_index;
+		
+		try
+		{
+			file.open(path);
+		} catch(const std::exception&)
+		{
+			throw std::runtime_error(std::string("Cannot open index ") + path);
+		}
+		
+		const char* data = file.data();
+		const size_t size = file.size();
+		
+		header = reinterpret_cast<const header_t*>(data);
+		if(size < sizeof(header_t) || memcmp(header->magic, magic, sizeof(magic)) != 0)
+			throw std::runtime_error(std::string("Not an index: ") + path);
+		
+		const size_t tables = sizeof(header_t)
+			+ header->resource_count * sizeof(resource_t)
+			+ header->block_count * sizeof(block_t)
+			+ header->interval_count * sizeof(interval_t)
+			+ header->string_count * sizeof(string_t);
+		
+		if(size < tables)
+			throw std::runtime_error(std::string("Truncated index ") + path);
+		
+		resources = reinterpret_cast<const resource_t*>(header + 1);
+		blocks = reinterpret_cast<const block_t*>(resources + header->resource_count);
+		intervals = reinterpret_cast<const interval_t*>(blocks + header->block_count);
+		strings = reinterpret_cast<const string_t*>(intervals + header->interval_count);
+		string_data = data + tables;
+		string_data_size = size - tables;
+	}
+	
+	boost::string_ref index_reader::string(const uint64_t id) const
+	{
+		if(id >= header->string_count || strings[id].offset + strings[id].size > string_data_size)
+			throw std::runtime_error("Corrupt index");
+		
+		return boost::string_ref(string_data + strings[id].offset, strings[id].size);
+	}
+	
+	void index_reader::query(const clock_t from, const clock_t to, const filter& selection, const index_reader::callback_t& f) const
+	{
+		using namespace interval_index;
+		
+		for(uint64_t r = 0; r < header->resource_count; r++)
+		{
+			const boost::string_ref resource = string(resources[r].name);
+			if(!selection.accepts(resource.to_string()))
+				continue;
+			
+			if(resources[r].first_block + resources[r].block_count > header->block_count)
+				throw std::runtime_error("Corrupt index");
+			
+			const block_t* begin = blocks + resources[r].first_block;
+			const block_t* end = begin + resources[r].block_count;
+			
+			// Blocks before the first ending at or after from only hold earlier intervals
+			const block_t* b = std::lower_bound(begin, end, from, [](const block_t& x, const clock_t t) {
+				return x.max_end < t;
+			});
+			
+			for(; b != end && b->min_start <= to; b++)
+			{
+				if(b->first_interval + b->interval_count > header->interval_count)
+					throw std::runtime_error("Corrupt index");
+				
+				for(const interval_t* i = intervals + b->first_interval; i != intervals + b->first_interval + b->interval_count; i++)
+				{
+					if(i->start > to)
+						break;
+					
+					if(i->end < from)
+						continue;
+					
+					const boost::string_ref label = string(i->label), scenario = string(i->scenario);
+					f({label, i->page_number, scenario, resource, i->event_id, startend_e::start, i->start, label});
+					f({label, i->page_number, scenario, resource, i->event_id, startend_e::end, i->end, label});
+				}
+			}
+		}
+	}
+}
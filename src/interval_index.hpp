@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include "filter.hpp"
+#include "octopus.hpp"
+
+namespace uppaal2octopus
+{
+	/* Index over the intervals of converted Octopus events, answering which
+	 * locations were active at a time or during a range without reading
+	 * the events themselves.
+	 *
+	 * The file starts with a header, followed by the resources sorted by
+	 * name, the blocks of every resource, the intervals of every block
+	 * sorted by start, and a string table. All fields are in native byte
+	 * order. A block summarises its intervals by their first start and the
+	 * latest end up to and including the block, so both are ascending and
+	 * the blocks of a range are found by binary search.
+	 */
+	namespace interval_index
+	{
+		struct header_t
+		{
+			char magic[8];
+			uint64_t resource_count, block_count, interval_count, string_count;
+		};
+		
+		struct resource_t
+		{
+			uint64_t name, first_block, block_count;
+		};
+		
+		struct block_t
+		{
+			uint32_t min_start, max_end;
+			uint64_t first_interval, interval_count;
+		};
+		
+		struct interval_t
+		{
+			uint32_t start, end, event_id, page_number;
+			uint32_t label, scenario; // Ids in the string table
+		};
+		
+		struct string_t
+		{
+			uint64_t offset, size;
+		};
+		
+		static const char magic[8] = {'u', '2', 'o', 'i', 'd', 'x', '\0', '1'};
+		static const size_t block_size = 256;
+	}
+	
+	/* Collects the intervals of events as they are converted, in any order,
+	 * and writes the index once they are all known. Intervals are kept per
+	 * resource until they exceed the memory budget, after which those of
+	 * every resource are sorted by start and spilled to a temporary file as
+	 * one run. Writing the index merges the runs resource by resource.
+	 */
+	class index_writer
+	{
+		// The intervals of a resource in a run
+		struct section_t
+		{
+			uint64_t offset, count; // In intervals
+		};
+		
+		struct run_t
+		{
+			FILE* file;
+			std::unordered_map<uint32_t, section_t> sections; // By resource
+		};
+		
+		size_t budget;
+		size_t used;
+		
+		std::unordered_map<std::string, uint32_t> string_ids;
+		std::vector<const std::string*> strings; // By id, the keys of string_ids
+		std::string key; // The string being looked up, reused
+		
+		std::map<std::string, uint64_t> resources; // Interval counts, in the order resources are written
+		std::unordered_map<uint32_t, std::vector<interval_index::interval_t>> buffered; // By resource
+		std::vector<run_t> runs;
+		std::unordered_map<uint32_t, std::pair<uint32_t, interval_index::interval_t>> open; // Resource and interval of started events by id
+		
+		index_writer(index_writer&) = delete;
+		void operator=(index_writer&) = delete;
+		
+		uint32_t string_id(const boost::string_ref str);
+		
+		void sort();
+		void spill();
+		
+		// Pass the intervals of a resource in all runs and the buffer, sorted by start.
+		void merge(const uint32_t resource, const std::function<void(const interval_index::interval_t&)>& f);
+	
+	public:
+		index_writer(const size_t budget);
+		~index_writer();
+		
+		void add(const octopus::event_t& e);
+		void write(const std::string& path);
+	};
+	
+	class index_reader
+	{
+	public:
+		typedef std::function<void(const octopus::event_t&)> callback_t;
+	
+	private:
+		boost::iostreams::mapped_file_source file;
+		
+		const interval_index::header_t* header;
+		const interval_index::resource_t* resources;
+		const interval_index::block_t* blocks;
+		const interval_index::interval_t* intervals;
+		const interval_index::string_t* strings;
+		const char* string_data;
+		size_t string_data_size;
+		
+		index_reader(index_reader&) = delete;
+		void operator=(index_reader&) = delete;
+		
+		boost::string_ref string(const uint64_t id) const;
+	
+	public:
+		index_reader(const std::string& path);
+		
+		// Pass the start and end events of the intervals of the accepted resources active at some time in [from, to].
+		void query(const clock_t from, const clock_t to, const filter& selection, const callback_t& f) const;
+	};
+}
@@ -0,0 +1,232 @@
+#include "uppaal2octopus.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <boost/iostreams/stream.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include "hrparser.hpp"
+#include "xmlparser.hpp"
+
+namespace uppaal2octopus
+{
+	library::columns_t::columns_t()
+	: jobId()
+	, pageNumber()
+	, scenario()
+	, resource()
+	, eventId()
+	, startEnd()
+	, timeStamp()
+	, label()
+	{}
+	
+	size_t library::columns_t::size() const
+	{
+		return eventId.size();
+	}
+	
+	void library::columns_t::clear()
+	{
+		jobId.clear();
+		pageNumber.clear();
+		scenario.clear();
+		resource.clear();
+		eventId.clear();
+		startEnd.clear();
+		timeStamp.clear();
+		label.clear();
+	}
+	
+	void library::columns_t::push_back(const octopus::event_t& e)
+	{
+		jobId.push_back(e.jobId.to_string());
+		pageNumber.push_back(e.pageNumber);
+		scenario.push_back(e.scenario.to_string());
+		resource.push_back(e.resource.to_string());
+		eventId.push_back(e.eventId);
+		startEnd.push_back(e.startEnd);
+		timeStamp.push_back(e.timeStamp);
+		label.push_back(e.label.to_string());
+	}
+	
+	library::sink_t library::columns_t::sink()
+	{
+		return [this](const octopus::event_t& e) {
+			push_back(e);
+		};
+	}
+	
+	library::library(const size_t threads, const filter& selection)
+	: selection(selection)
+	, parser(threads, selection)
+	{}
+	
+	library::model_t library::load_model(const std::string& path) const
+	{
+		const auto m = std::make_shared<xtrparser::model_t>();
+		parser.load(*m, path);
+		return m;
+	}
+	
+	library::model_t library::load_model(const char* data, const size_t size) const
+	{
+		const auto m = std::make_shared<xtrparser::model_t>();
+		parser.load(*m, data, size);
+		return m;
+	}
+	
+	library::model_t library::load_model(std::istream& is) const
+	{
+		const std::string data((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+		return load_model(data.data(), data.size());
+	}
+	
+	void library::convert_hr(const std::string& path, const library::sink_t& sink) const
+	{
+		std::ifstream is(path);
+		if(!is)
+			throw std::runtime_error(std::string("Cannot open trace ") + path);
+		
+		convert_hr(is, sink);
+	}
+	
+	void library::convert_hr(const char* data, const size_t size, const library::sink_t& sink) const
+	{
+		boost::iostreams::stream<boost::iostreams::array_source> is(data, size);
+		convert_hr(is, sink);
+	}
+	
+	void library::convert_hr(std::istream& is, const library::sink_t& sink) const
+	{
+		converter c(sink);
+		
+		hrparser::parse(is, [&](const location_t& loc, const clock_t clock, const startend_e startEnd) {
+			c.add(loc, clock, startEnd);
+		}, selection);
+		
+		c.flush();
+	}
+	
+	void library::convert_xml(const library::model_t& m, const std::string& path, const library::sink_t& sink) const
+	{
+		std::ifstream is(path);
+		if(!is)
+			throw std::runtime_error(std::string("Cannot open trace ") + path);
+		
+		convert_xml(m, is, sink);
+	}
+	
+	void library::convert_xml(const library::model_t& m, const char* data, const size_t size, const library::sink_t& sink) const
+	{
+		boost::iostreams::stream<boost::iostreams::array_source> is(data, size);
+		convert_xml(m, is, sink);
+	}
+	
+	void library::convert_xml(const library::model_t& m, std::istream& is, const library::sink_t& sink) const
+	{
+		converter c(sink);
+		
+		xmlparser::parse(*m, is, [&](const location_t& loc, const clock_t clock, const startend_e startEnd) {
+			c.add(loc, clock, startEnd);
+		}, selection);
+		
+		c.flush();
+	}
+	
+	void library::convert_xtr(const library::model_t& m, const std::string& path, const library::sink_t& sink) const
+	{
+		boost::iostreams::mapped_file_source trace(path);
+		convert_xtr(m, trace.data(), trace.size(), sink);
+	}
+	
+	void library::convert_xtr(const library::model_t& m, const char* data, const size_t size, const library::sink_t& sink) const
+	{
+		converter c(sink);
+		
+		parser.parse(*m, data, size, [&](const location_t& loc, const clock_t clock, const startend_e startEnd) {
+			c.add(loc, clock, startEnd);
+		});
+		
+		c.flush();
+	}
+	
+	void library::convert_xtr(const library::model_t& m, std::istream& is, const library::sink_t& sink) const
+	{
+		const std::string data((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+		convert_xtr(m, data.data(), data.size(), sink);
+	}
+	
+	event_reader::source_t library::source_hr(const std::string& path) const
+	{
+		const auto is = std::make_shared<std::ifstream>(path);
+		if(!*is)
+			throw std::runtime_error(std::string("Cannot open trace ") + path);
+		
+		const auto p = std::make_shared<hrparser>(*is, selection);
+		return [is, p](const event_reader::location_callback_t& f) {
+			return p->next(f);
+		};
+	}
+	
+	event_reader::source_t library::source_xml(const library::model_t& m, const std::string& path) const
+	{
+		const auto is = std::make_shared<std::ifstream>(path);
+		if(!*is)
+			throw std::runtime_error(std::string("Cannot open trace ") + path);
+		
+		const auto p = std::make_shared<xmlparser>(*m, *is, selection);
+		return [m, is, p](const event_reader::location_callback_t& f) {
+			return p->next(f);
+		};
+	}
+	
+	event_reader::source_t library::source_xtr(const library::model_t& m, const std::string& path) const
+	{
+		const auto trace = std::make_shared<boost::iostreams::mapped_file_source>(path);
+		const auto p = std::make_shared<xtrparser::stepper>(parser, *m, trace->data(), trace->size());
+		return [m, trace, p](const event_reader::location_callback_t& f) {
+			return p->next(f);
+		};
+	}
+	
+	std::unique_ptr<event_reader> library::read_hr(const std::string& path, const std::string& scenario, const library::ids_t& ids) const
+	{
+		return std::unique_ptr<event_reader>(new event_reader(source_hr(path), scenario, ids));
+	}
+	
+	std::unique_ptr<event_reader> library::read_hr(std::istream& is, const std::string& scenario, const library::ids_t& ids) const
+	{
+		const auto p = std::make_shared<hrparser>(is, selection);
+		return std::unique_ptr<event_reader>(new event_reader([p](const event_reader::location_callback_t& f) {
+			return p->next(f);
+		}, scenario, ids));
+	}
+	
+	std::unique_ptr<event_reader> library::read_xml(const library::model_t& m, const std::string& path, const std::string& scenario, const library::ids_t& ids) const
+	{
+		return std::unique_ptr<event_reader>(new event_reader(source_xml(m, path), scenario, ids));
+	}
+	
+	std::unique_ptr<event_reader> library::read_xml(const library::model_t& m, std::istream& is, const std::string& scenario, const library::ids_t& ids) const
+	{
+		const auto p = std::make_shared<xmlparser>(*m, is, selection);
+		return std::unique_ptr<event_reader>(new event_reader([m, p](const event_reader::location_callback_t& f) {
+			return p->next(f);
+		}, scenario, ids));
+	}
+	
+	std::unique_ptr<event_reader> library::read_xtr(const library::model_t& m, const std::string& path, const std::string& scenario, const library::ids_t& ids) const
+	{
+		return std::unique_ptr<event_reader>(new event_reader(source_xtr(m, path), scenario, ids));
+	}
+	
+	std::unique_ptr<event_reader> library::read_xtr(const library::model_t& m, const char* data, const size_t size, const std::string& scenario, const library::ids_t& ids) const
+	{
+		const auto p = std::make_shared<xtrparser::stepper>(parser, *m, data, size);
+		return std::unique_ptr<event_reader>(new event_reader([m, p](const event_reader::location_callback_t& f) {
+			return p->next(f);
+		}, scenario, ids));
+	}
+}
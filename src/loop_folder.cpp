@@ -0,0 +1,189 @@
+#include "loop_folder.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace uppaal2octopus
+{
+	static const uint64_t hash_base = 0x100000001b3ULL;
+	
+	loop_folder::process_loops_t::process_loops_t()
+	: last_end(0)
+	, history()
+	, prefixes(1, 0)
+	, pending(0)
+	, cycle()
+	, iterations(0)
+	, loop_end(0)
+	, partial()
+	{}
+	
+	loop_folder::loop_folder(const loop_folder::callback_t& f, const size_t max_period)
+	: f(f)
+	, max_period(max_period)
+	, powers(max_period + 1, 1)
+	, names()
+	, ids()
+	, locations()
+	, processes()
+	{
+		if(max_period == 0)
+			throw std::runtime_error("The period of loops must be at least 1");
+		
+		for(size_t k = 1; k <= max_period; k++)
+			powers[k] = powers[k - 1] * hash_base;
+	}
+	
+	name_t loop_folder::own(const std::string& name)
+	{
+		return name_t(*names.insert(name).first);
+	}
+	
+	uint64_t loop_folder::hash(const loop_folder::interval_t& x)
+	{
+		// splitmix64 over the fields compared
+		uint64_t h = (static_cast<uint64_t>(x.id) << 32) ^ (static_cast<uint64_t>(x.end - x.start) * 0x9e3779b97f4a7c15ULL) ^ x.gap;
+		h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+		return h ^ (h >> 31);
+	}
+	
+	void loop_folder::add(const location_t& l, const clock_t start, const clock_t end)
+	{
+		auto id_i = ids.find(l);
+		if(id_i == ids.end())
+		{
+			const location_t owned(own(std::string(l.first.data(), l.first.size())), own(std::string(l.second.data(), l.second.size())));
+			id_i = ids.insert(std::make_pair(owned, locations.size())).first;
+			locations.push_back(owned);
+		}
+		
+		const size_t id = id_i->second;
+		process_loops_t& p = processes[locations[id].first];
+		
+		const interval_t x = {id, start, end, start - p.last_end};
+		p.last_end = end;
+		
+		if(!p.cycle.empty())
+		{
+			if(x == p.cycle[p.partial.size()])
+			{
+				p.partial.push_back(x);
+				
+				if(p.partial.size() == p.cycle.size())
+				{
+					p.iterations++;
+					p.loop_end = x.end;
+					p.partial.clear();
+				}
+				
+				return;
+			}
+			
+			close_loop(p);
+		}
+		
+		append(p, x);
+	}
+	
+	void loop_folder::emit(const loop_folder::interval_t& x)
+	{
+		f(locations[x.id], x.start, x.end);
+	}
+	
+	void loop_folder::append(loop_folder::process_loops_t& p, const loop_folder::interval_t& x)
+	{
+		p.history.push_back(x);
+		p.prefixes.push_back(p.prefixes.back() * hash_base + hash(x));
+		p.pending++;
+		
+		const size_t n = p.history.size();
+		for(size_t k = 1; k <= max_period && 2 * k <= n; k++)
+		{
+			const uint64_t last = p.prefixes[n] - p.prefixes[n - k] * powers[k];
+			const uint64_t before = p.prefixes[n - k] - p.prefixes[n - 2 * k] * powers[k];
+			
+			if(last != before || !std::equal(p.history.end() - static_cast<ptrdiff_t>(k), p.history.end(), p.history.end() - static_cast<ptrdiff_t>(2 * k)))
+				continue;
+			
+			// The last k intervals repeat the k before, which are passed on as the first iteration
+			release(p, k);
+			
+			p.cycle.assign(p.history.end() - static_cast<ptrdiff_t>(k), p.history.end());
+			p.iterations = 1;
+			p.loop_end = x.end;
+			
+			p.history.clear();
+			p.prefixes.assign(1, 0);
+			p.pending = 0;
+			return;
+		}
+		
+		release(p, max_period);
+		
+		// Only the last two periods are compared, drop older intervals now and then
+		if(n > 4 * max_period)
+		{
+			p.history.erase(p.history.begin(), p.history.end() - static_cast<ptrdiff_t>(2 * max_period));
+			
+			p.prefixes.assign(1, 0);
+			for(const interval_t& y : p.history)
+				p.prefixes.push_back(p.prefixes.back() * hash_base + hash(y));
+		}
+	}
+	
+	void loop_folder::close_loop(loop_folder::process_loops_t& p)
+	{
+		if(p.iterations == 1)
+		{
+			// A single repetition is not worth folding
+			for(const interval_t& y : p.cycle)
+				emit(y);
+		}
+		else
+		{
+			std::string name = "(";
+			for(const interval_t& y : p.cycle)
+			{
+				if(name.size() > 1)
+					name.push_back(' ');
+				
+				const location_name_t& l = locations[y.id].second;
+				name.append(l.data(), l.size());
+			}
+			
+			name.append(")*");
+			name.append(std::to_string(p.iterations));
+			
+			f(location_t(locations[p.cycle.front().id].first, own(name)), p.cycle.front().start, p.loop_end);
+		}
+		
+		for(const interval_t& y : p.partial)
+			emit(y);
+		
+		p.cycle.clear();
+		p.partial.clear();
+		p.iterations = 0;
+	}
+	
+	void loop_folder::release(loop_folder::process_loops_t& p, const size_t keep)
+	{
+		for(; p.pending > keep; p.pending--)
+		{
+			emit(p.history[p.history.size() - p.pending]);
+		}
+	}
+	
+	void loop_folder::flush()
+	{
+		for(auto& pp : processes)
+		{
+			if(!pp.second.cycle.empty())
+				close_loop(pp.second);
+			
+			release(pp.second, 0);
+		}
+		
+		processes.clear();
+	}
+}
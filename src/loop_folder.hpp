@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "concepts.hpp"
+
+namespace uppaal2octopus
+{
+	/* Folds cycles in the locations of each process, like the lasso of a
+	 * liveness counterexample. An interval is identified by its location,
+	 * its duration and its distance to the previous interval of the
+	 * process. Once the last k intervals of a process repeat the k before
+	 * them, for k up to the maximum period, the first iteration is passed
+	 * on as is. Further iterations are counted instead. When the cycle is
+	 * broken, they are passed on as one interval over all of them, at the
+	 * location "(<location> ...)*<iterations>".
+	 *
+	 * Repeats are found with a polynomial hash over the prefixes of the
+	 * recent intervals, comparing the last k intervals to the k before in
+	 * constant time per period. Intervals are held back for at most the
+	 * maximum period, so that the second iteration can still be folded.
+	 */
+	class loop_folder
+	{
+	public:
+		typedef std::function<void(const location_t& l, const clock_t start, const clock_t end)> callback_t;
+	
+	private:
+		struct interval_t
+		{
+			size_t id; // Of the location
+			clock_t start, end;
+			clock_t gap; // Since the end of the previous interval of the process
+			
+			bool operator==(const interval_t& rhs) const
+			{
+				return id == rhs.id && end - start == rhs.end - rhs.start && gap == rhs.gap;
+			}
+		};
+		
+		struct process_loops_t
+		{
+			clock_t last_end;
+			
+			// Intervals since the last loop, the last pending of which are not passed on yet
+			std::vector<interval_t> history;
+			std::vector<uint64_t> prefixes; // prefixes[i] hashes history[0, i)
+			size_t pending;
+			
+			// The second iteration of the current loop, empty if there is none
+			std::vector<interval_t> cycle;
+			size_t iterations; // Following the first, including the second
+			clock_t loop_end;
+			std::vector<interval_t> partial; // Of the iteration after the last complete one
+			
+			process_loops_t();
+		};
+		
+		callback_t f;
+		size_t max_period;
+		std::vector<uint64_t> powers; // Of the hash base, up to the maximum period
+		
+		// Held back intervals may outlive the parser naming them, so their names are copied
+		std::set<std::string> names;
+		std::map<location_t, size_t> ids;
+		std::vector<location_t> locations; // By id
+		std::map<process_t, process_loops_t> processes;
+		
+		loop_folder(loop_folder&) = delete;
+		void operator=(loop_folder&) = delete;
+		
+		name_t own(const std::string& name);
+		static uint64_t hash(const interval_t& x);
+		
+		void emit(const interval_t& x);
+		void append(process_loops_t& p, const interval_t& x);
+		void close_loop(process_loops_t& p);
+		void release(process_loops_t& p, const size_t keep);
+	
+	public:
+		loop_folder(const callback_t& f, const size_t max_period);
+		
+		// An interval of a location, in the order the intervals of its process end.
+		void add(const location_t& l, const clock_t start, const clock_t end);
+		
+		// Pass on all held back intervals, at the end of a trace.
+		void flush();
+	};
+}
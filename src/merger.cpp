@@ -0,0 +1,35 @@
+#include "merger.hpp"
+
+namespace uppaal2octopus
+{
+	merger::merger()
+	: inputs()
+	, heads()
+	{}
+	
+	void merger::push(const size_t i)
+	{
+		clock_t t;
+		if(inputs[i]->close_time(t))
+			heads.emplace(t, i);
+	}
+	
+	void merger::add(std::unique_ptr<event_reader> input)
+	{
+		inputs.push_back(std::move(input));
+		push(inputs.size() - 1);
+	}
+	
+	bool merger::next(octopus::event_t& e)
+	{
+		if(heads.empty())
+			return false;
+		
+		const size_t i = heads.top().second;
+		heads.pop();
+		
+		inputs[i]->next(e);
+		push(i);
+		return true;
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <memory>
+#include <queue>
+#include <vector>
+
+#include "octopus.hpp"
+#include "event_reader.hpp"
+
+namespace uppaal2octopus
+{
+	/* Merges the events of several traces into a single stream, using a
+	 * k-way merge on the time the interval of the next event of each trace
+	 * ends. Only one pending interval per trace is kept, ties go to the
+	 * earliest added trace.
+	 *
+	 * A trace is not ordered by the start of its intervals, as they are
+	 * only passed on once they end, so neither is the merged stream: it is
+	 * ordered by the end of the intervals. Pass it through a sorter for a
+	 * timeline.
+	 */
+	class merger
+	{
+		typedef std::pair<clock_t, size_t> head_t; // Close time of the next event, input
+		
+		std::vector<std::unique_ptr<event_reader>> inputs;
+		std::priority_queue<head_t, std::vector<head_t>, std::greater<head_t>> heads;
+		
+		merger(merger&) = delete;
+		void operator=(merger&) = delete;
+		
+		void push(const size_t i);
+	
+	public:
+		merger();
+		
+		void add(std::unique_ptr<event_reader> input);
+		
+		// Take the next event of the trace whose next interval ends first; false if all have ended.
+		bool next(octopus::event_t& e);
+	};
+}
@@ -0,0 +1,63 @@
+#include "model_cache.hpp"
+
+#include <sys/stat.h>
+
+namespace uppaal2octopus
+{
+	model_cache::model_cache(const library& lib, const size_t capacity)
+	: lib(lib)
+	, capacity(capacity)
+	, entries()
+	, index()
+	, mutex()
+	{}
+	
+	library::model_t model_cache::get(const std::string& path)
+	{
+		struct stat st;
+		if(stat(path.c_str(), &st) != 0)
+			throw std::runtime_error(std::string("Cannot open model ") + path);
+		
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			
+			const auto i = index.find(path);
+			if(i != index.end())
+			{
+				const entry_t& e = *i->second;
+				if(e.mtime.tv_sec == st.st_mtim.tv_sec && e.mtime.tv_nsec == st.st_mtim.tv_nsec)
+				{
+					entries.splice(entries.begin(), entries, i->second);
+					return e.model;
+				}
+				
+				entries.erase(i->second);
+				index.erase(i);
+			}
+		}
+		
+		// Load without holding the lock, other jobs need not wait for it
+		const library::model_t m = lib.load_model(path);
+		
+		std::lock_guard<std::mutex> lock(mutex);
+		
+		// Another job may have loaded the same model meanwhile
+		const auto i = index.find(path);
+		if(i != index.end())
+		{
+			entries.erase(i->second);
+			index.erase(i);
+		}
+		
+		entries.push_front({path, st.st_mtim, m});
+		index[path] = entries.begin();
+		
+		while(entries.size() > capacity)
+		{
+			index.erase(entries.back().path);
+			entries.pop_back();
+		}
+		
+		return m;
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <ctime>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "uppaal2octopus.hpp"
+
+namespace uppaal2octopus
+{
+	/* Keeps the most recently used models loaded, so that converting many
+	 * xtr traces of the same model only parses it once. A model is loaded
+	 * again when its file has been modified since.
+	 */
+	class model_cache
+	{
+		struct entry_t
+		{
+			std::string path;
+			timespec mtime;
+			library::model_t model;
+		};
+		
+		const library& lib;
+		const size_t capacity;
+		
+		// Most recently used first
+		std::list<entry_t> entries;
+		std::unordered_map<std::string, std::list<entry_t>::iterator> index;
+		std::mutex mutex;
+		
+		model_cache(model_cache&) = delete;
+		void operator=(model_cache&) = delete;
+	
+	public:
+		model_cache(const library& lib, const size_t capacity);
+		
+		// The model at path, loaded by lib if not cached. Safe to call from several threads.
+		library::model_t get(const std::string& path);
+	};
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <ostream>
+#include <boost/utility/string_ref.hpp>
 #include "concepts.hpp"
 
 namespace uppaal2octopus
@@ -8,15 +9,19 @@ namespace uppaal2octopus
 	class octopus
 	{
 	public:
+		/* The strings refer to the storage of the producer of the event,
+		 * such as the converter, and are valid during the callback it is
+		 * passed to. Events of an event_reader stay valid while it lives.
+		 */
 		struct event_t
 		{
-			std::string jobId;
+			boost::string_ref jobId;
 			uint32_t pageNumber;
-			std::string scenario, resource;
+			boost::string_ref scenario, resource;
 			uint32_t eventId;
 			startend_e startEnd;
 			uint32_t timeStamp;
-			std::string label;
+			boost::string_ref label;
 		};
 	};
 }
@@ -36,22 +41,3 @@ namespace std
 		}
 	}
 }
-
-namespace uppaal2octopus
-{
-	inline std::ostream& operator<<(std::ostream& o, const octopus::event_t& rhs)
-	{
-		const static char sep = '\t';
-		
-		o	<< rhs.jobId << sep
-			<< rhs.pageNumber << sep
-			<< rhs.scenario << sep
-			<< rhs.resource << sep
-			<< rhs.eventId << sep
-			<< std::to_string(rhs.startEnd) << sep
-			<< rhs.timeStamp << sep
-			<< '"' << rhs.label << '"';
-		
-		return o;
-	}
-}
@@ -2,7 +2,9 @@
 
 #include <set>
 #include <queue>
+#include <vector>
 #include <algorithm>
+#include <stdexcept>
 
 namespace uppaal2octopus
 {
@@ -43,20 +45,28 @@ namespace uppaal2octopus
 			std::set<object_t> m; //set of marked id_t's
 			edges_t h;
 			
+			edges_t adjacent(graph);
+			std::sort(adjacent.begin(), adjacent.end()); //Group edges by their source
+			
 			m.insert(start);
 			q.emplace(start);
 			
 			while(!q.empty())
 			{
-				id_t t = q.front();
+				const object_t t = q.front();
 				q.pop();
 				
 				if(t == end)
 					return reconstruct(h, start, end);
 				
-				for(const edge_t& e : graph)
+				auto e_i = std::lower_bound(adjacent.begin(), adjacent.end(), t, [](const edge_t& e, const object_t o) {
+					return e.first < o;
+				});
+				
+				for(; e_i != adjacent.end() && e_i->first == t; e_i++)
 				{
-					if(e.first == t && m.find(e.second) == m.end())
+					const edge_t& e = *e_i;
+					if(m.find(e.second) == m.end())
 					{
 						m.insert(e.second);
 						q.emplace(e.second);
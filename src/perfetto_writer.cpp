@@ -0,0 +1,128 @@
+#include "perfetto_writer.hpp"
+
+namespace uppaal2octopus
+{
+	// Field numbers of the messages in perfetto/protos/perfetto/trace/
+	enum perfetto_field_e
+	{
+		trace_packet = 1,
+		
+		packet_timestamp = 8,
+		packet_trusted_packet_sequence_id = 10,
+		packet_track_event = 11,
+		packet_sequence_flags = 13,
+		packet_track_descriptor = 60,
+		
+		track_descriptor_uuid = 1,
+		track_descriptor_name = 2,
+		
+		track_event_type = 9,
+		track_event_track_uuid = 11,
+		track_event_name = 23
+	};
+	
+	enum perfetto_wire_e
+	{
+		wire_varint = 0,
+		wire_bytes = 2
+	};
+	
+	const uint32_t perfetto_sequence_id = 1;
+	const uint64_t perfetto_slice_begin = 1, perfetto_slice_end = 2;
+	const uint64_t perfetto_incremental_state_cleared = 1;
+	
+	void inline put_varint(std::vector<char>& b, uint64_t x)
+	{
+		while(x >= 0x80)
+		{
+			b.push_back(static_cast<char>((x & 0x7f) | 0x80));
+			x >>= 7;
+		}
+		
+		b.push_back(static_cast<char>(x));
+	}
+	
+	void inline put_tag(std::vector<char>& b, const uint32_t field, const perfetto_wire_e wire)
+	{
+		put_varint(b, (static_cast<uint64_t>(field) << 3) | wire);
+	}
+	
+	void inline put_uint(std::vector<char>& b, const uint32_t field, const uint64_t x)
+	{
+		put_tag(b, field, wire_varint);
+		put_varint(b, x);
+	}
+	
+	void inline put_bytes(std::vector<char>& b, const uint32_t field, const char* data, const size_t size)
+	{
+		put_tag(b, field, wire_bytes);
+		put_varint(b, size);
+		b.insert(b.end(), data, data + size);
+	}
+
+	perfetto_writer::perfetto_writer(std::ostream& os)
+	: os(os)
+	, tracks()
+	, started(false)
+	, message()
+	, packet()
+	{}
+	
+	void perfetto_writer::write_packet()
+	{
+		put_uint(packet, packet_trusted_packet_sequence_id, perfetto_sequence_id);
+		
+		// Tell the reader that the sequence starts here, as there is no earlier state to rely on
+		if(!started)
+		{
+			put_uint(packet, packet_sequence_flags, perfetto_incremental_state_cleared);
+			started = true;
+		}
+		
+		message.clear();
+		put_bytes(message, trace_packet, packet.data(), packet.size());
+		os.write(message.data(), message.size());
+		
+		packet.clear();
+	}
+	
+	uint64_t perfetto_writer::track(const process_t& p)
+	{
+		const auto t_i = tracks.find(p);
+		if(t_i != tracks.end())
+			return t_i->second;
+		
+		const uint64_t uuid = tracks.size() + 1;
+		tracks.insert(std::make_pair(p, uuid));
+		
+		message.clear();
+		put_uint(message, track_descriptor_uuid, uuid);
+		put_bytes(message, track_descriptor_name, p.data(), p.size());
+		
+		put_bytes(packet, packet_track_descriptor, message.data(), message.size());
+		write_packet();
+		
+		return uuid;
+	}
+	
+	void perfetto_writer::slice(const uint64_t track, const uint64_t timestamp, const bool begin, const location_name_t& name)
+	{
+		message.clear();
+		put_uint(message, track_event_type, begin ? perfetto_slice_begin : perfetto_slice_end);
+		put_uint(message, track_event_track_uuid, track);
+		if(begin)
+			put_bytes(message, track_event_name, name.data(), name.size());
+		
+		put_uint(packet, packet_timestamp, timestamp * 1000);
+		put_bytes(packet, packet_track_event, message.data(), message.size());
+		write_packet();
+	}
+	
+	void perfetto_writer::add(const location_t& l, const clock_t start, const clock_t end)
+	{
+		const uint64_t t = track(l.first);
+		
+		slice(t, start, true, l.second);
+		slice(t, end, false, l.second);
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "concepts.hpp"
+
+namespace uppaal2octopus
+{
+	/* Writes intervals as a Perfetto trace, in the protobuf format read by
+	 * ui.perfetto.dev and trace_processor. Every process becomes a track and
+	 * every interval a slice on it, named after the location.
+	 *
+	 * The trace is streamed: each slice is written as a begin and end
+	 * packet as soon as it is known, and a track is described right before
+	 * its first slice. Packets are encoded in reused buffers. One unit of
+	 * the clock is written as one microsecond.
+	 */
+	class perfetto_writer
+	{
+		std::ostream& os;
+		std::map<process_t, uint64_t> tracks;
+		bool started;
+		
+		std::vector<char> message, packet;
+		
+		perfetto_writer(perfetto_writer&) = delete;
+		void operator=(perfetto_writer&) = delete;
+		
+		void write_packet();
+		uint64_t track(const process_t& p);
+		void slice(const uint64_t track, const uint64_t timestamp, const bool begin, const location_name_t& name);
+	
+	public:
+		perfetto_writer(std::ostream& os);
+		
+		void add(const location_t& l, const clock_t start, const clock_t end);
+	};
+}
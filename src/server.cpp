@@ -0,0 +1,235 @@
+#include "server.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <boost/asio.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "sorter.hpp"
+
+namespace uppaal2octopus
+{
+	typedef boost::asio::local::stream_protocol protocol_t;
+	
+	server::job_t::job_t()
+	: action()
+	, trace()
+	, model()
+	, sorted(false)
+	, data()
+	{}
+	
+	// Fields other than the inline trace are at most this long, so a bad size is not allocated
+	static const size_t max_field_size = 1 << 16;
+	
+	// Time a client has to send its job
+	static const std::chrono::seconds job_timeout(30);
+	
+	void inline write_field(std::ostream& os, const std::string& field)
+	{
+		os << field.size() << '\n';
+		os.write(field.data(), static_cast<std::streamsize>(field.size()));
+	}
+	
+	std::string inline read_field(std::istream& is, const size_t max_size)
+	{
+		std::string line;
+		if(!std::getline(is, line))
+			throw std::runtime_error("Failed to read job");
+		
+		size_t size;
+		try
+		{
+			size = boost::lexical_cast<size_t>(line);
+		} catch(const boost::bad_lexical_cast&)
+		{
+			throw std::runtime_error("Malformed job");
+		}
+		
+		if(size > max_size)
+			throw std::runtime_error("Job field of " + line + " bytes exceeds the limit of " + boost::lexical_cast<std::string>(max_size) + " bytes");
+		
+		// Grow with the bytes actually received rather than the size announced
+		std::string field;
+		while(field.size() < size)
+		{
+			const size_t offset = field.size();
+			field.resize(offset + std::min(size - offset, max_field_size));
+			
+			if(!is.read(&field[offset], static_cast<std::streamsize>(field.size() - offset)))
+				throw std::runtime_error("Failed to read job");
+		}
+		
+		return field;
+	}
+	
+	void inline write_job(std::ostream& os, const server::job_t& job)
+	{
+		write_field(os, job.action);
+		write_field(os, job.trace);
+		write_field(os, job.model);
+		write_field(os, job.sorted ? "1" : "0");
+		write_field(os, job.data);
+		os.flush();
+	}
+	
+	// The inline trace is at most max_data_size bytes
+	server::job_t inline read_job(std::istream& is, const size_t max_data_size)
+	{
+		server::job_t job;
+		job.action = read_field(is, max_field_size);
+		job.trace = read_field(is, max_field_size);
+		job.model = read_field(is, max_field_size);
+		job.sorted = read_field(is, max_field_size) == "1";
+		job.data = read_field(is, max_data_size);
+		
+		return job;
+	}
+
+	server::server(const std::string& path, const size_t threads, const size_t cache_size, const size_t memory, const filter& selection)
+	: path(path)
+	, memory(memory)
+	, lib(1, selection)
+	, models(lib, cache_size)
+	, workers(threads)
+	{}
+	
+	void server::convert(const server::job_t& job, const library::sink_t& sink)
+	{
+		const bool inline_trace = job.trace == "";
+		
+		if(job.action == "hr")
+		{
+			if(inline_trace)
+				lib.convert_hr(job.data.data(), job.data.size(), sink);
+			else
+				lib.convert_hr(job.trace, sink);
+		}
+		else if(job.action == "xml")
+		{
+			const library::model_t m = models.get(job.model);
+			
+			if(inline_trace)
+				lib.convert_xml(m, job.data.data(), job.data.size(), sink);
+			else
+				lib.convert_xml(m, job.trace, sink);
+		}
+		else if(job.action == "xtr")
+		{
+			const library::model_t m = models.get(job.model);
+			
+			if(inline_trace)
+				lib.convert_xtr(m, job.data.data(), job.data.size(), sink);
+			else
+				lib.convert_xtr(m, job.trace, sink);
+		}
+		else
+			throw std::runtime_error("Unknown action '" + job.action + "'");
+	}
+	
+	void inline write_error(std::ostream& os, const std::exception& e)
+	{
+		os << '\n' << "error: " << e.what() << std::endl;
+	}
+	
+	void server::handle(std::iostream& s, const server::job_t& job)
+	{
+		try
+		{
+			event_writer<tsv_format> writer(s);
+			const library::sink_t print = [&](const octopus::event_t& e) {
+				writer.add(e);
+			};
+			
+			if(job.sorted)
+			{
+				sorter sorted(print, memory);
+				convert(job, [&](const octopus::event_t& e) {
+					sorted.add(e);
+				});
+				sorted.flush();
+			}
+			else
+				convert(job, print);
+			
+			if(!s.flush())
+				throw std::runtime_error("Failed to write events");
+			
+			s << '\n' << "ok" << std::endl;
+		} catch(const std::exception& e)
+		{
+			write_error(s, e);
+		}
+	}
+	
+	void server::run()
+	{
+		// Clients going away should not take the server with them
+		signal(SIGPIPE, SIG_IGN);
+		
+		// Only replace a socket left behind, never another file
+		struct stat st;
+		if(lstat(path.c_str(), &st) == 0)
+		{
+			if(!S_ISSOCK(st.st_mode))
+				throw std::runtime_error("Cannot serve on " + path + ", which exists and is not a socket");
+			
+			unlink(path.c_str());
+		}
+		
+		boost::asio::io_service io;
+		
+		// Jobs name paths opened as the server user, so only that user may connect
+		const mode_t mask = umask(0177);
+		protocol_t::acceptor acceptor(io, protocol_t::endpoint(path));
+		umask(mask);
+		
+		std::cerr << "Serving on " << path << " with " << workers.size() << " workers" << std::endl;
+		
+		for(;;)
+		{
+			const auto s = std::make_shared<protocol_t::iostream>();
+			acceptor.accept(*s->rdbuf());
+			
+			workers.post([this, s]() {
+				job_t job;
+				try
+				{
+					s->expires_after(job_timeout);
+					job = read_job(*s, memory);
+					s->expires_at(protocol_t::iostream::time_point::max());
+				} catch(const std::exception& e)
+				{
+					return write_error(*s, e);
+				}
+				
+				handle(*s, job);
+			});
+		}
+	}
+	
+	void server::submit(const std::string& path, const server::job_t& job, std::ostream& out)
+	{
+		const protocol_t::endpoint endpoint(path);
+		protocol_t::iostream s(endpoint);
+		if(!s)
+			throw std::runtime_error("Cannot connect to server at " + path);
+		
+		// A job the server refuses is answered before it is read in full
+		write_job(s, job);
+		s.clear();
+		
+		std::string line;
+		while(std::getline(s, line) && line != "")
+			out << line << '\n';
+		
+		if(!std::getline(s, line))
+			throw std::runtime_error("Lost connection to server");
+		
+		if(line != "ok")
+			throw std::runtime_error(line);
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "uppaal2octopus.hpp"
+#include "model_cache.hpp"
+#include "thread_pool.hpp"
+
+namespace uppaal2octopus
+{
+	/* A long-lived conversion daemon, accepting jobs over a Unix domain
+	 * socket. Jobs run on a pool of workers and share the loaded models, so
+	 * a job only pays for converting its trace.
+	 *
+	 * A job is a sequence of fields, each written as its size in bytes on
+	 * a line of its own followed by the bytes themselves, so that paths may
+	 * hold any character:
+	 *
+	 *   <action> <trace> <model> <sorted> <data>
+	 *
+	 * The action is hr, xml or xtr, paths are absolute and an empty trace
+	 * means the data holds the trace, of at most the memory budget. A job
+	 * must arrive within 30 seconds. Events are always streamed back, the
+	 * server does not write files on behalf of its clients. The reply ends
+	 * with an empty line, followed by either "ok" or "error: <message>".
+	 *
+	 * The socket is only accessible to the user running the server, since
+	 * jobs name files that the server opens with its own privileges.
+	 */
+	class server
+	{
+	public:
+		struct job_t
+		{
+			std::string action, trace, model;
+			bool sorted;
+			std::string data; // The trace, if not read from a path
+			
+			job_t();
+		};
+	
+	private:
+		const std::string path;
+		const size_t memory;
+		
+		library lib;
+		model_cache models;
+		thread_pool workers;
+		
+		server(server&) = delete;
+		void operator=(server&) = delete;
+		
+		void handle(std::iostream& s, const job_t& job);
+		void convert(const job_t& job, const library::sink_t& sink);
+	
+	public:
+		// Serve on the socket at path, running jobs on the given number of workers (0 means all cores),
+		// keeping at most cache_size models loaded and sorting in at most memory bytes per job.
+		server(const std::string& path, const size_t threads, const size_t cache_size, const size_t memory, const filter& selection = filter());
+		
+		// Accept jobs until the process is terminated.
+		void run();
+		
+		// Run a job on the server at path, writing streamed back events to out. Throws on failure of the job.
+		static void submit(const std::string& path, const job_t& job, std::ostream& out);
+	};
+}
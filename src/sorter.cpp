@@ -0,0 +1,209 @@
+#include "sorter.hpp"
+
+#include <algorithm>
+#include <queue>
+#include <stdexcept>
+
+namespace uppaal2octopus
+{
+	void inline write_uint(FILE* file, const uint32_t x)
+	{
+		if(fwrite(&x, sizeof(x), 1, file) != 1)
+			throw std::runtime_error("Failed to write sorted run");
+	}
+	
+	void inline write_string(FILE* file, const boost::string_ref str)
+	{
+		write_uint(file, static_cast<uint32_t>(str.size()));
+		if(str.size() > 0 && fwrite(str.data(), 1, str.size(), file) != str.size())
+			throw std::runtime_error("Failed to write sorted run");
+	}
+	
+	bool inline read_uint(FILE* file, uint32_t& x)
+	{
+		return fread(&x, sizeof(x), 1, file) == 1;
+	}
+	
+	bool inline read_string(FILE* file, std::string& str)
+	{
+		uint32_t size;
+		if(!read_uint(file, size))
+			return false;
+		
+		str.resize(size);
+		return size == 0 || fread(&str[0], 1, size, file) == size;
+	}
+	
+	void inline write_event(FILE* file, const octopus::event_t& e)
+	{
+		write_string(file, e.jobId);
+		write_uint(file, e.pageNumber);
+		write_string(file, e.scenario);
+		write_string(file, e.resource);
+		write_uint(file, e.eventId);
+		write_uint(file, e.startEnd == startend_e::start ? 0 : 1);
+		write_uint(file, e.timeStamp);
+		write_string(file, e.label);
+	}
+	
+	// The next event of a run, with the strings it refers to
+	struct head_t
+	{
+		octopus::event_t e;
+		std::string jobId, scenario, resource, label;
+	};
+	
+	bool inline read_event(FILE* file, head_t& h)
+	{
+		octopus::event_t& e = h.e;
+		uint32_t startEnd;
+		
+		if(!read_string(file, h.jobId))
+			return false;
+		
+		if(!read_uint(file, e.pageNumber)
+			|| !read_string(file, h.scenario)
+			|| !read_string(file, h.resource)
+			|| !read_uint(file, e.eventId)
+			|| !read_uint(file, startEnd)
+			|| !read_uint(file, e.timeStamp)
+			|| !read_string(file, h.label))
+			throw std::runtime_error("Failed to read sorted run");
+		
+		e.jobId = h.jobId;
+		e.scenario = h.scenario;
+		e.resource = h.resource;
+		e.label = h.label;
+		e.startEnd = startEnd == 0 ? startend_e::start : startend_e::end;
+		return true;
+	}
+
+	sorter::sorter(const sorter::callback_t& f, const size_t budget)
+	: f(f)
+	, budget(budget)
+	, used(0)
+	, buffer()
+	, strings()
+	, key()
+	, runs()
+	{}
+	
+	sorter::~sorter()
+	{
+		for(FILE* run : runs)
+			fclose(run);
+	}
+	
+	boost::string_ref sorter::own(const boost::string_ref str)
+	{
+		key.assign(str.data(), str.size());
+		const auto i = strings.insert(key);
+		
+		if(i.second)
+			used += key.size();
+		
+		return *i.first;
+	}
+	
+	void sorter::sort()
+	{
+		std::stable_sort(buffer.begin(), buffer.end(), [](const octopus::event_t& x, const octopus::event_t& y) {
+			return x.timeStamp < y.timeStamp;
+		});
+	}
+	
+	void sorter::spill()
+	{
+		sort();
+		
+		FILE* run = tmpfile();
+		if(run == NULL)
+			throw std::runtime_error("Cannot create temporary file for sorting");
+		
+		runs.push_back(run);
+		
+		for(const octopus::event_t& e : buffer)
+			write_event(run, e);
+		
+		if(fflush(run) != 0)
+			throw std::runtime_error("Failed to write sorted run");
+		
+		buffer.clear();
+		strings.clear();
+		used = 0;
+	}
+	
+	void sorter::merge()
+	{
+		typedef std::pair<uint32_t, size_t> queued_t; // timeStamp, run; the in-memory run is last
+		
+		std::vector<head_t> heads(runs.size());
+		std::priority_queue<queued_t, std::vector<queued_t>, std::greater<queued_t>> q;
+		size_t next_buffered = 0;
+		
+		for(size_t i = 0; i < runs.size(); i++)
+		{
+			rewind(runs[i]);
+			if(read_event(runs[i], heads[i]))
+				q.emplace(heads[i].e.timeStamp, i);
+		}
+		
+		if(next_buffered < buffer.size())
+			q.emplace(buffer[next_buffered].timeStamp, runs.size());
+		
+		while(!q.empty())
+		{
+			const size_t i = q.top().second;
+			q.pop();
+			
+			if(i == runs.size())
+			{
+				f(buffer[next_buffered++]);
+				
+				if(next_buffered < buffer.size())
+					q.emplace(buffer[next_buffered].timeStamp, i);
+			}
+			else
+			{
+				f(heads[i].e);
+				
+				if(read_event(runs[i], heads[i]))
+					q.emplace(heads[i].e.timeStamp, i);
+			}
+		}
+	}
+	
+	void sorter::add(const octopus::event_t& e)
+	{
+		buffer.push_back(e);
+		
+		octopus::event_t& owned = buffer.back();
+		owned.jobId = own(e.jobId);
+		owned.scenario = own(e.scenario);
+		owned.resource = own(e.resource);
+		owned.label = own(e.label);
+		used += sizeof(e);
+		
+		if(used > budget)
+			spill();
+	}
+	
+	void sorter::flush()
+	{
+		sort();
+		
+		if(runs.empty())
+			for(const octopus::event_t& e : buffer)
+				f(e);
+		else
+			merge();
+		
+		for(FILE* run : runs)
+			fclose(run);
+		
+		runs.clear();
+		buffer.clear();
+		strings.clear();
+		used = 0;
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "octopus.hpp"
+
+namespace uppaal2octopus
+{
+	/* Reorders events by timestamp, keeping the original order of events
+	 * with equal timestamps. Events are sorted in memory until they exceed
+	 * the memory budget, after which sorted runs are spilled to temporary
+	 * files and merged when flushing. The strings of buffered events are
+	 * kept once each, as labels and resources repeat.
+	 */
+	class sorter
+	{
+	public:
+		typedef std::function<void(const octopus::event_t&)> callback_t;
+	
+	private:
+		callback_t f;
+		size_t budget;
+		size_t used;
+		
+		std::vector<octopus::event_t> buffer;
+		std::unordered_set<std::string> strings; // Referred to by the buffered events
+		std::string key; // The string being looked up, reused
+		std::vector<FILE*> runs;
+		
+		sorter(sorter&) = delete;
+		void operator=(sorter&) = delete;
+		
+		boost::string_ref own(const boost::string_ref str);
+		
+		void sort();
+		void spill();
+		void merge();
+	
+	public:
+		sorter(const callback_t& f, const size_t budget);
+		~sorter();
+		
+		void add(const octopus::event_t& e);
+		void flush();
+	};
+}
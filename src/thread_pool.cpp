@@ -0,0 +1,108 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+namespace uppaal2octopus
+{
+	thread_pool::thread_pool(size_t n)
+	: workers()
+	, jobs()
+	, mutex()
+	, cv()
+	, stopping(false)
+	{
+		if(n == 0)
+			n = std::max(1u, std::thread::hardware_concurrency());
+		
+		for(size_t i = 0; i < n; i++)
+			workers.emplace_back([this]() { work(); });
+	}
+	
+	thread_pool::~thread_pool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		
+		cv.notify_all();
+		
+		for(std::thread& t : workers)
+			t.join();
+	}
+	
+	void thread_pool::work()
+	{
+		for(;;)
+		{
+			job_t job;
+			
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cv.wait(lock, [this]() { return stopping || !jobs.empty(); });
+				
+				if(jobs.empty())
+					return;
+				
+				job = std::move(jobs.front());
+				jobs.pop();
+			}
+			
+			job();
+		}
+	}
+	
+	void thread_pool::post(const job_t& job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push(job);
+		}
+		
+		cv.notify_one();
+	}
+	
+	void thread_pool::parallel_for(size_t n, const std::function<void(size_t)>& f)
+	{
+		parallel_for_stripes(n, [&](const size_t i, const size_t) {
+			f(i);
+		});
+	}
+	
+	void thread_pool::parallel_for_stripes(size_t n, const std::function<void(size_t, size_t)>& f)
+	{
+		const size_t stripes = std::min(n, workers.size());
+		
+		std::mutex done_mutex;
+		std::condition_variable done_cv;
+		size_t remaining = stripes;
+		std::exception_ptr error;
+		
+		for(size_t s = 0; s < stripes; s++)
+			post([&, s]() {
+				std::exception_ptr e;
+				
+				try
+				{
+					for(size_t i = s; i < n; i += stripes)
+						f(i, s);
+				} catch(...)
+				{
+					e = std::current_exception();
+				}
+				
+				std::lock_guard<std::mutex> lock(done_mutex);
+				if(e && !error)
+					error = e;
+				
+				if(--remaining == 0)
+					done_cv.notify_all();
+			});
+		
+		std::unique_lock<std::mutex> lock(done_mutex);
+		done_cv.wait(lock, [&]() { return remaining == 0; });
+		
+		if(error)
+			std::rethrow_exception(error);
+	}
+}
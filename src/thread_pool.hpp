@@ -0,0 +1,53 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace uppaal2octopus
+{
+	/* A fixed set of worker threads executing posted jobs in FIFO order.
+	 */
+	class thread_pool
+	{
+	public:
+		typedef std::function<void()> job_t;
+	
+	private:
+		std::vector<std::thread> workers;
+		std::queue<job_t> jobs;
+		
+		std::mutex mutex;
+		std::condition_variable cv;
+		bool stopping;
+		
+		thread_pool(thread_pool&) = delete;
+		void operator=(thread_pool&) = delete;
+		
+		void work();
+	
+	public:
+		// Spawns n workers; 0 means one worker per hardware thread.
+		thread_pool(size_t n);
+		~thread_pool();
+		
+		size_t size() const
+		{
+			return workers.size();
+		}
+		
+		void post(const job_t& job);
+		
+		// Runs f(i) for all 0 <= i < n on the workers and blocks until all are done.
+		// The first exception thrown by f is rethrown in the calling thread.
+		void parallel_for(size_t n, const std::function<void(size_t)>& f);
+		
+		// As parallel_for, passing f the stripe of workers calling it as well. Calls of the same
+		// stripe, which is below size(), never run at the same time, so it can index scratch space.
+		void parallel_for_stripes(size_t n, const std::function<void(size_t i, size_t stripe)>& f);
+	};
+}
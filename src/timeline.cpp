@@ -0,0 +1,75 @@
+#include "timeline.hpp"
+
+#include <stdexcept>
+
+namespace uppaal2octopus
+{
+	timeline::timeline(std::ostream& os)
+	: os(os)
+	, last()
+	, deltas()
+	, count(0)
+	, states(0)
+	{}
+	
+	void timeline::write_run()
+	{
+		os << count;
+		for(const int64_t d : deltas)
+			os << '\t' << d;
+		
+		os << '\n';
+	}
+	
+	void timeline::add(const clock_t clock, const std::vector<std::string>& names, const std::vector<int>& values)
+	{
+		if(states == 0)
+		{
+			os << "count\ttime";
+			for(const std::string& name : names)
+				os << '\t' << name;
+			
+			os << '\n';
+			
+			last.assign(values.size() + 1, 0);
+			deltas.assign(values.size() + 1, 0);
+		}
+		
+		if(values.size() + 1 != last.size())
+			throw std::runtime_error("Number of values changed within the trace");
+		
+		// Extend the pending run if the changes are the same, otherwise start a new one
+		bool same = count > 0 && static_cast<int64_t>(clock) - last[0] == deltas[0];
+		for(size_t i = 0; same && i < values.size(); i++)
+			same = values[i] - last[i + 1] == deltas[i + 1];
+		
+		if(same)
+			count++;
+		else
+		{
+			if(count > 0)
+				write_run();
+			
+			deltas[0] = static_cast<int64_t>(clock) - last[0];
+			for(size_t i = 0; i < values.size(); i++)
+				deltas[i + 1] = values[i] - last[i + 1];
+			
+			count = 1;
+		}
+		
+		last[0] = clock;
+		for(size_t i = 0; i < values.size(); i++)
+			last[i + 1] = values[i];
+		
+		states++;
+	}
+	
+	void timeline::flush()
+	{
+		if(count > 0)
+			write_run();
+		
+		count = 0;
+		os.flush();
+	}
+}
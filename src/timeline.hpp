@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "concepts.hpp"
+
+namespace uppaal2octopus
+{
+	/* Writes the values of every state of a trace as they are parsed, with
+	 * a column per value.
+	 *
+	 * The values are delta- and run-length encoded: every row holds the
+	 * changes of the columns from one state to the next (the first state
+	 * is relative to 0), preceded by the number of consecutive states that
+	 * have exactly these changes. As most values rarely change, long runs
+	 * of states take a single row.
+	 *
+	 * The written file is tab separated, with a header row
+	 * count\ttime\t<name>..., where time holds the clock c.
+	 */
+	class timeline
+	{
+		std::ostream& os;
+		std::vector<int64_t> last; // The values of the previous state, time first
+		std::vector<int64_t> deltas; // The changes of the pending run
+		size_t count; // The number of states in the pending run
+		size_t states;
+		
+		timeline(timeline&) = delete;
+		void operator=(timeline&) = delete;
+		
+		void write_run();
+	
+	public:
+		timeline(std::ostream& os);
+		
+		// Add a state; the first state determines the columns.
+		void add(const clock_t clock, const std::vector<std::string>& names, const std::vector<int>& values);
+		
+		// Write the last run, after the last state.
+		void flush();
+		
+		size_t size() const
+		{
+			return states;
+		}
+	};
+}
@@ -0,0 +1,54 @@
+#include "transition_log.hpp"
+
+namespace uppaal2octopus
+{
+	transition_log::transition_log()
+	: ids()
+	, edges()
+	, transitions()
+	, transition_edges()
+	{}
+	
+	void transition_log::add(const clock_t clock, const std::vector<std::vector<std::string>>& es)
+	{
+		std::string key;
+		
+		for(const auto& e : es)
+		{
+			key.clear();
+			for(const std::string& field : e)
+			{
+				if(!key.empty())
+					key.push_back('\t');
+				
+				key.append(field);
+			}
+			
+			const auto i = ids.emplace(key, edges.size());
+			if(i.second)
+				edges.push_back(&i.first->first);
+			
+			transition_edges.push_back(i.first->second);
+		}
+		
+		transitions.push_back({clock, es.size()});
+	}
+	
+	void transition_log::write(std::ostream& os) const
+	{
+		os << "edges\n";
+		for(size_t i = 0; i < edges.size(); i++)
+			os << i << '\t' << *edges[i] << '\n';
+		
+		os << "transitions\n";
+		size_t j = 0;
+		for(const transition_t& t : transitions)
+		{
+			os << t.clock;
+			for(size_t k = 0; k < t.edge_count; k++)
+				os << (k == 0 ? '\t' : ' ') << transition_edges[j++];
+			
+			os << '\n';
+		}
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "concepts.hpp"
+
+namespace uppaal2octopus
+{
+	/* Collects the edges taken by every transition of a trace, with their
+	 * guard, synchronisation and updates.
+	 *
+	 * Edges are stored once in a dictionary, as the same edge is usually
+	 * taken with the same annotations many times; a transition only refers
+	 * to the ids of its edges.
+	 *
+	 * The written file lists the dictionary, one edge per line as
+	 * <id>\t<from>-><to>\t<guard>\t<sync>\t<update>..., followed by the
+	 * transitions as <clock>\t<id> <id>...
+	 */
+	class transition_log
+	{
+		struct transition_t
+		{
+			clock_t clock;
+			size_t edge_count;
+		};
+		
+		std::unordered_map<std::string, size_t> ids;
+		std::vector<const std::string*> edges; // By id, the keys of ids
+		
+		std::vector<transition_t> transitions;
+		std::vector<size_t> transition_edges;
+	
+	public:
+		transition_log();
+		
+		// Add a transition; an edge is its "<from>-><to>", followed by its guard, synchronisation and updates.
+		void add(const clock_t clock, const std::vector<std::vector<std::string>>& edges);
+		
+		size_t size() const
+		{
+			return transitions.size();
+		}
+		
+		void write(std::ostream& os) const;
+	};
+}
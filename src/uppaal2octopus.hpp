@@ -0,0 +1,101 @@
+#pragma once
+
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "concepts.hpp"
+#include "octopus.hpp"
+#include "event_format.hpp"
+#include "converter.hpp"
+#include "filter.hpp"
+#include "event_reader.hpp"
+#include "xtrparser.hpp"
+
+namespace uppaal2octopus
+{
+	/* In-process interface for programs linking against libuppaal2octopus.
+	 *
+	 * Traces can be read from a path, a memory buffer or a stream. The
+	 * resulting events are handed to a sink, or collected column-wise.
+	 * Unlike the command line tool, errors are thrown to the caller.
+	 */
+	class library
+	{
+	public:
+		typedef converter::callback_t sink_t;
+		
+		// A model in intermediate format, loaded once for any number of xtr and xml traces.
+		typedef std::shared_ptr<const xtrparser::model_t> model_t;
+		
+		// Converted events, stored per field.
+		struct columns_t
+		{
+			std::vector<std::string> jobId;
+			std::vector<uint32_t> pageNumber;
+			std::vector<std::string> scenario, resource;
+			std::vector<uint32_t> eventId;
+			std::vector<startend_e> startEnd;
+			std::vector<uint32_t> timeStamp;
+			std::vector<std::string> label;
+			
+			columns_t();
+			
+			size_t size() const;
+			void clear();
+			void push_back(const octopus::event_t& e);
+			
+			// A sink appending to these columns.
+			sink_t sink();
+		};
+	
+	private:
+		filter selection;
+		xtrparser parser;
+		
+		library(library&) = delete;
+		void operator=(library&) = delete;
+	
+	public:
+		// Decode states of xtr traces on the given number of threads (0 means all cores),
+		// and convert only the processes and locations accepted by the filter.
+		library(const size_t threads = 1, const filter& selection = filter());
+		
+		model_t load_model(const std::string& path) const;
+		model_t load_model(const char* data, const size_t size) const;
+		model_t load_model(std::istream& is) const;
+		
+		void convert_hr(const std::string& path, const sink_t& sink) const;
+		void convert_hr(const char* data, const size_t size, const sink_t& sink) const;
+		void convert_hr(std::istream& is, const sink_t& sink) const;
+		
+		void convert_xml(const model_t& m, const std::string& path, const sink_t& sink) const;
+		void convert_xml(const model_t& m, const char* data, const size_t size, const sink_t& sink) const;
+		void convert_xml(const model_t& m, std::istream& is, const sink_t& sink) const;
+		
+		void convert_xtr(const model_t& m, const std::string& path, const sink_t& sink) const;
+		void convert_xtr(const model_t& m, const char* data, const size_t size, const sink_t& sink) const;
+		void convert_xtr(const model_t& m, std::istream& is, const sink_t& sink) const;
+		
+		/* Pull based variants, producing events on demand. A stream or
+		 * buffer passed in must outlive the reader, a path is owned by it.
+		 * Readers sharing ids get unique event and location ids.
+		 */
+		typedef std::shared_ptr<converter::ids_t> ids_t;
+		
+		std::unique_ptr<event_reader> read_hr(const std::string& path, const std::string& scenario = "UPPAALtrace", const ids_t& ids = std::make_shared<converter::ids_t>()) const;
+		std::unique_ptr<event_reader> read_hr(std::istream& is, const std::string& scenario = "UPPAALtrace", const ids_t& ids = std::make_shared<converter::ids_t>()) const;
+		
+		std::unique_ptr<event_reader> read_xml(const model_t& m, const std::string& path, const std::string& scenario = "UPPAALtrace", const ids_t& ids = std::make_shared<converter::ids_t>()) const;
+		std::unique_ptr<event_reader> read_xml(const model_t& m, std::istream& is, const std::string& scenario = "UPPAALtrace", const ids_t& ids = std::make_shared<converter::ids_t>()) const;
+		
+		std::unique_ptr<event_reader> read_xtr(const model_t& m, const std::string& path, const std::string& scenario = "UPPAALtrace", const ids_t& ids = std::make_shared<converter::ids_t>()) const;
+		std::unique_ptr<event_reader> read_xtr(const model_t& m, const char* data, const size_t size, const std::string& scenario = "UPPAALtrace", const ids_t& ids = std::make_shared<converter::ids_t>()) const;
+		
+		// The states of a trace at a path, for an event_reader or other consumers of location changes.
+		event_reader::source_t source_hr(const std::string& path) const;
+		event_reader::source_t source_xml(const model_t& m, const std::string& path) const;
+		event_reader::source_t source_xtr(const model_t& m, const std::string& path) const;
+	};
+}
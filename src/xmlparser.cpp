@@ -0,0 +1,379 @@
+#include "xmlparser.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <boost/lexical_cast.hpp>
+
+namespace uppaal2octopus
+{
+	template<typename T>
+	xmlparser::definitions_t<T>::definitions_t()
+	: values()
+	, used()
+	{}
+	
+	template<typename T>
+	const T* xmlparser::definitions_t<T>::find(const std::string& id) const
+	{
+		const auto i = values.find(id);
+		return i == values.end() ? nullptr : &i->second;
+	}
+	
+	template<typename T>
+	const T& xmlparser::definitions_t<T>::use(const std::string& id)
+	{
+		if(id != used)
+		{
+			values.erase(used);
+			used = id;
+		}
+		
+		return values.at(id);
+	}
+	
+	xmlparser::xmlparser(const xtrparser::model_t& m, std::istream& is, const filter& selection, const xmlparser::state_callback_t& on_state, const xmlparser::clocks_callback_t& on_clocks)
+	: m(m)
+	, tokens(is)
+	, token()
+	, started(false)
+	, processes(m.processes.size(), false)
+	, locations(m.layout.size(), false)
+	, current(m.processes.size(), -1)
+	, last(0)
+	, t0(0)
+	, c(0)
+	, first()
+	, nodes()
+	, pending()
+	, location_vectors()
+	, zones()
+	, variable_vectors()
+	, bounds(m.clocks.size())
+	, lower_bounds()
+	, on_state(on_state)
+	, on_clocks(on_clocks)
+	{
+		for(size_t p = 0; p < m.processes.size(); p++)
+		{
+			processes[p] = selection.accepts(m.processes[p].name);
+			
+			if(processes[p])
+				for(const int l : m.processes[p].locations)
+					locations[l] = selection.accepts(m.processes[p].name, m.layout[l].name);
+		}
+		
+		bool found_t0 = false, found_c = false;
+		for(size_t i = 0; i < m.clocks.size(); i++)
+		{
+			if(m.clocks[i] == "t(0)")
+			{
+				t0 = i;
+				found_t0 = true;
+			}
+			else if(m.clocks[i] == "c")
+			{
+				c = i;
+				found_c = true;
+			}
+		}
+		
+		if(!found_t0 || !found_c)
+			throw std::runtime_error("The model has no clocks t(0) and c");
+	}
+	
+	const std::string& xmlparser::attribute(const char* name) const
+	{
+		const std::string* value = token.attribute(name);
+		if(value == nullptr)
+			throw std::runtime_error(std::string("Missing attribute '") + name + "' in element '" + token.name + "'");
+		
+		return *value;
+	}
+	
+	size_t xmlparser::id(const std::string& str, const size_t size, const char* kind)
+	{
+		size_t x;
+		try
+		{
+			x = boost::lexical_cast<size_t>(str);
+		} catch(const boost::bad_lexical_cast&)
+		{
+			throw std::runtime_error(std::string("Invalid ") + kind + " '" + str + "' in XML trace");
+		}
+		
+		if(x >= size)
+			throw std::runtime_error(std::string("Unknown ") + kind + " '" + str + "' in XML trace");
+		
+		return x;
+	}
+	
+	void xmlparser::skip_element()
+	{
+		for(size_t depth = 1; depth > 0;)
+		{
+			if(!tokens.next(token))
+				throw std::runtime_error("Unexpected end of XML trace");
+			
+			if(token.kind == xmltokenizer::kind_e::start)
+				depth++;
+			else
+				depth--;
+		}
+	}
+	
+	void xmlparser::read_location_vector()
+	{
+		// Only the locations of the first node are needed
+		if(started)
+			return skip_element();
+		
+		std::vector<int>& cells = location_vectors.values[attribute("id")];
+		cells.clear();
+		
+		std::istringstream ss(attribute("locations"));
+		for(std::string l; ss >> l;)
+			cells.push_back(static_cast<int>(id(l, m.layout.size(), "location")));
+		
+		if(cells.size() != m.processes.size())
+			throw std::runtime_error("Location vector does not list all processes");
+		
+		skip_element();
+	}
+	
+	void xmlparser::read_dbm_instance()
+	{
+		zone_t& zone = zones.values[attribute("id")];
+		
+		bounds.clear();
+		
+		// Clocks are not negative
+		for(size_t i = 0; i < m.clocks.size(); i++)
+			bounds.set(t0, i, 0);
+		
+		while(tokens.next(token) && token.kind == xmltokenizer::kind_e::start)
+		{
+			if(token.name == "clockbound")
+			{
+				const size_t i = id(attribute("clock1"), m.clocks.size(), "clock");
+				const size_t j = id(attribute("clock2"), m.clocks.size(), "clock");
+				
+				if(i != j)
+					bounds.set(i, j, boost::lexical_cast<int32_t>(attribute("bound")));
+			}
+			
+			skip_element();
+		}
+		
+		if(token.kind != xmltokenizer::kind_e::end || token.name != "dbm_instance")
+			throw std::runtime_error("Unterminated dbm_instance in XML trace");
+		
+		bounds.lower_bounds(t0, lower_bounds);
+		zone.clock = static_cast<clock_t>(lower_bounds[c]);
+		
+		if(on_clocks)
+			zone.clocks = lower_bounds;
+	}
+	
+	void xmlparser::read_variable_vector()
+	{
+		if(!on_state)
+			return skip_element();
+		
+		std::vector<int>& values = variable_vectors.values[attribute("id")];
+		values.assign(m.variables.size(), 0);
+		
+		while(tokens.next(token) && token.kind == xmltokenizer::kind_e::start)
+		{
+			if(token.name == "variable_state")
+				values[id(attribute("variable"), m.variables.size(), "variable")] = boost::lexical_cast<int>(attribute("value"));
+			
+			skip_element();
+		}
+		
+		if(token.kind != xmltokenizer::kind_e::end || token.name != "variable_vector")
+			throw std::runtime_error("Unterminated variable_vector in XML trace");
+	}
+	
+	void xmlparser::read_node()
+	{
+		node_t& n = nodes[attribute("id")];
+		n.location_vector = started ? std::string() : attribute("location_vector");
+		n.dbm_instance = attribute("dbm_instance");
+		n.variable_vector = on_state ? attribute("variable_vector") : std::string();
+		
+		// The first node of the trace is the one listed first
+		if(first.empty())
+			first = attribute("id");
+		
+		skip_element();
+	}
+	
+	void xmlparser::read_transition()
+	{
+		if(first.empty())
+			throw std::runtime_error("Transition before the first node in XML trace");
+		
+		pending.push_back(transition_t());
+		transition_t& t = pending.back();
+		t.from = attribute("from");
+		t.to = attribute("to");
+		
+		std::istringstream ss(attribute("edges"));
+		for(std::string e; ss >> e;)
+			t.edges.push_back(static_cast<int>(id(e, m.edges.size(), "edge")));
+		
+		skip_element();
+	}
+	
+	bool xmlparser::ready(const std::string& node) const
+	{
+		const auto n_i = nodes.find(node);
+		if(n_i == nodes.end())
+			return false;
+		
+		const node_t& n = n_i->second;
+		return (started || location_vectors.find(n.location_vector))
+			&& zones.find(n.dbm_instance)
+			&& (n.variable_vector.empty() || variable_vectors.find(n.variable_vector));
+	}
+	
+	void xmlparser::enter(const xmlparser::node_t& n, clock_t& clock)
+	{
+		const zone_t& zone = zones.use(n.dbm_instance);
+		clock = zone.clock;
+		
+		if(on_state)
+			on_state(clock, m.variables, variable_vectors.use(n.variable_vector));
+		
+		if(on_clocks)
+			on_clocks(clock, m.clocks, zone.clocks);
+	}
+	
+	location_t xmlparser::location(const size_t process, const int cell) const
+	{
+		return location_t(m.processes[process].name, m.layout[cell].name);
+	}
+	
+	void xmlparser::start(const xmlparser::callback_t& f)
+	{
+		const node_t& n = nodes.at(first);
+		
+		clock_t clock;
+		enter(n, clock);
+		
+		const std::vector<int>& cells = location_vectors.use(n.location_vector);
+		for(size_t p = 0; p < current.size(); p++)
+		{
+			current[p] = cells[p];
+			
+			if(processes[p] && locations[cells[p]])
+				f(location(p, cells[p]), clock, startend_e::start);
+		}
+		
+		// Location vectors are not read anymore
+		location_vectors.values.clear();
+		
+		last = clock;
+		started = true;
+	}
+	
+	void xmlparser::take(const xmlparser::transition_t& t, const xmlparser::callback_t& f)
+	{
+		clock_t clock;
+		enter(nodes.at(t.to), clock);
+		
+		// The source node is done with
+		if(t.from != t.to)
+			nodes.erase(t.from);
+		
+		for(const int e : t.edges)
+		{
+			const auto& edge = m.edges[e];
+			const size_t p = static_cast<size_t>(edge.process);
+			
+			if(p >= current.size() || current[p] != edge.source)
+				throw std::runtime_error("Transition does not start at the location of its process");
+			
+			current[p] = edge.target;
+			
+			if(!processes[p])
+				continue;
+			
+			if(locations[edge.source])
+				f(location(p, edge.source), clock, startend_e::end);
+			
+			if(locations[edge.target])
+				f(location(p, edge.target), clock, startend_e::start);
+		}
+		
+		last = clock;
+	}
+	
+	bool xmlparser::next(const xmlparser::callback_t& f)
+	{
+		for(;;)
+		{
+			if(!started && !first.empty() && ready(first))
+			{
+				start(f);
+				return true;
+			}
+			
+			if(started && !pending.empty() && ready(pending.front().to))
+			{
+				take(pending.front(), f);
+				pending.pop_front();
+				return true;
+			}
+			
+			if(!tokens.next(token))
+				break;
+			
+			if(token.kind != xmltokenizer::kind_e::start || token.name == "trace")
+				continue;
+			
+			if(token.name == "node")
+				read_node();
+			else if(token.name == "transition")
+				read_transition();
+			else if(token.name == "location_vector")
+				read_location_vector();
+			else if(token.name == "dbm_instance")
+				read_dbm_instance();
+			else if(token.name == "variable_vector")
+				read_variable_vector();
+			else
+				skip_element();
+		}
+		
+		if(first.empty())
+			throw std::runtime_error("No node in XML trace");
+		
+		if(!started || !pending.empty())
+			throw std::runtime_error("Unknown node '" + (started ? pending.front().to : first) + "' or its definitions in XML trace");
+		
+		// End of the trace
+		for(size_t p = 0; p < current.size(); p++)
+			if(processes[p] && current[p] >= 0 && locations[current[p]])
+				f(location(p, current[p]), last, startend_e::end);
+		
+		current.assign(current.size(), -1);
+		return false;
+	}
+	
+	void xmlparser::parse(const xtrparser::model_t& m, const std::string file, const xmlparser::callback_t& f, const filter& selection, const xmlparser::state_callback_t& on_state, const xmlparser::clocks_callback_t& on_clocks)
+	{
+		std::ifstream is(file);
+		if(!is)
+			throw std::runtime_error(std::string("Cannot open trace ") + file);
+		
+		parse(m, is, f, selection, on_state, on_clocks);
+	}
+	
+	void xmlparser::parse(const xtrparser::model_t& m, std::istream& is, const xmlparser::callback_t& f, const filter& selection, const xmlparser::state_callback_t& on_state, const xmlparser::clocks_callback_t& on_clocks)
+	{
+		xmlparser p(m, is, selection, on_state, on_clocks);
+		while(p.next(f));
+	}
+}
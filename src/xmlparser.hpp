@@ -0,0 +1,153 @@
+#pragma once
+
+#include <deque>
+#include <istream>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "concepts.hpp"
+#include "dbm.hpp"
+#include "filter.hpp"
+#include "xmltokenizer.hpp"
+#include "xtrparser.hpp"
+
+namespace uppaal2octopus
+{
+	/* Parser for the XML traces written by UPPAAL, read with a streaming
+	 * tokenizer so that no document tree is built. Like xtr traces, they
+	 * refer to the elements of the model by id, which are resolved through
+	 * the model in intermediate format:
+	 *
+	 * <trace>
+	 *   <location_vector id="lv0" locations="10 14"/>
+	 *   <dbm_instance id="d0">
+	 *     <clockbound clock1="0" clock2="1" bound="-5" comp="&lt;="/> ...
+	 *   </dbm_instance>
+	 *   <variable_vector id="vv0">
+	 *     <variable_state variable="0" value="3"/> ...
+	 *   </variable_vector>
+	 *   <node id="n0" location_vector="lv0" dbm_instance="d0" variable_vector="vv0"/>
+	 *   <transition from="n0" to="n1" edges="2 9"/>
+	 *   ...
+	 * </trace>
+	 *
+	 * Locations are layout cells, edges are numbered in the order of the
+	 * edges section, and clocks and variables by their number, as in the
+	 * intermediate format. A clock bound reads clock1 - clock2 < bound (or
+	 * <= bound); the clock c is its lower bound relative to t(0) implied by
+	 * the bounds. Other elements and attributes are ignored.
+	 *
+	 * Only the locations of the first node are read, the others follow from
+	 * the edges of the transitions. Definitions and nodes are kept until
+	 * they are no longer referred to: a node until the transition leaving
+	 * it, a definition until a later node refers to another one. A
+	 * transition waits for its target node and the definitions it refers
+	 * to, which may follow it in the document.
+	 */
+	class xmlparser
+	{
+	public:
+		typedef std::function<void(const location_t& loc, const clock_t clock, const startend_e startEnd)> callback_t;
+		typedef std::function<void(const clock_t clock, const std::vector<std::string>& names, const std::vector<int>& values)> state_callback_t;
+		typedef state_callback_t clocks_callback_t;
+	
+	private:
+		struct node_t
+		{
+			std::string location_vector, dbm_instance, variable_vector;
+		};
+		
+		struct transition_t
+		{
+			std::string from, to;
+			std::vector<int> edges;
+		};
+		
+		// The clock c and, if requested, the lower bounds of all clocks of a dbm_instance
+		struct zone_t
+		{
+			clock_t clock;
+			std::vector<int> clocks;
+		};
+		
+		/* Definitions of one kind by id. The one used by the last node is
+		 * dropped once a node uses another one.
+		 */
+		template<typename T>
+		struct definitions_t
+		{
+			std::unordered_map<std::string, T> values;
+			std::string used;
+			
+			definitions_t();
+			
+			const T* find(const std::string& id) const;
+			const T& use(const std::string& id);
+		};
+		
+		const xtrparser::model_t& m;
+		
+		xmltokenizer tokens;
+		xmltokenizer::token_t token;
+		bool started;
+		
+		// The filter resolved for this model, per process and per layout cell
+		std::vector<bool> processes, locations;
+		
+		// The location of every process, as a layout cell, or -1 before the first node
+		std::vector<int> current;
+		clock_t last;
+		size_t t0; // The reference clock
+		size_t c;
+		
+		std::string first; // The node listed first, where the trace starts
+		std::unordered_map<std::string, node_t> nodes;
+		std::deque<transition_t> pending; // Transitions waiting for their target
+		
+		definitions_t<std::vector<int>> location_vectors;
+		definitions_t<zone_t> zones;
+		definitions_t<std::vector<int>> variable_vectors;
+		
+		dbm bounds;
+		std::vector<int> lower_bounds;
+		
+		state_callback_t on_state;
+		clocks_callback_t on_clocks;
+		
+		xmlparser(xmlparser&) = delete;
+		void operator=(xmlparser&) = delete;
+		
+		const std::string& attribute(const char* name) const;
+		
+		// The id of an element of the model, at most size - 1
+		static size_t id(const std::string& str, const size_t size, const char* kind);
+		
+		void skip_element();
+		void read_location_vector();
+		void read_dbm_instance();
+		void read_variable_vector();
+		void read_node();
+		void read_transition();
+		
+		// Whether a node and the definitions it refers to are known
+		bool ready(const std::string& node) const;
+		
+		void enter(const node_t& n, clock_t& clock);
+		void start(const callback_t& f);
+		void take(const transition_t& t, const callback_t& f);
+		
+		location_t location(const size_t process, const int cell) const;
+	
+	public:
+		// The model must outlive the parser.
+		xmlparser(const xtrparser::model_t& m, std::istream& is, const filter& selection = filter(), const state_callback_t& on_state = nullptr, const clocks_callback_t& on_clocks = nullptr);
+		
+		// Parse the next state of the trace; false if the trace has ended.
+		bool next(const callback_t& f);
+		
+		static void parse(const xtrparser::model_t& m, const std::string file, const callback_t& f, const filter& selection = filter(), const state_callback_t& on_state = nullptr, const clocks_callback_t& on_clocks = nullptr);
+		static void parse(const xtrparser::model_t& m, std::istream& is, const callback_t& f, const filter& selection = filter(), const state_callback_t& on_state = nullptr, const clocks_callback_t& on_clocks = nullptr);
+	};
+}
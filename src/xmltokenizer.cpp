@@ -0,0 +1,263 @@
+#include "xmltokenizer.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace uppaal2octopus
+{
+	void inline xml_error()
+	{
+		throw std::runtime_error("Failed to parse XML trace");
+	}
+	
+	bool inline is_xml_space(const int c)
+	{
+		return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+	}
+	
+	bool inline is_name_char(const int c)
+	{
+		return c != EOF && !is_xml_space(c) && c != '/' && c != '>' && c != '=' && c != '<';
+	}
+
+	xmltokenizer::token_t::token_t()
+	: kind(kind_e::start)
+	, name()
+	, attributes()
+	, attribute_count(0)
+	{}
+	
+	const std::string* xmltokenizer::token_t::attribute(const char* name) const
+	{
+		for(size_t i = 0; i < attribute_count; i++)
+			if(attributes[i].first == name)
+				return &attributes[i].second;
+		
+		return nullptr;
+	}
+
+	xmltokenizer::xmltokenizer(std::istream& is)
+	: is(is)
+	, buffer(1 << 16)
+	, pos(0)
+	, size(0)
+	, pending_end(false)
+	{}
+	
+	bool xmltokenizer::fill()
+	{
+		if(pos < size)
+			return true;
+		
+		is.read(buffer.data(), buffer.size());
+		size = static_cast<size_t>(is.gcount());
+		pos = 0;
+		
+		return size > 0;
+	}
+	
+	int xmltokenizer::peek()
+	{
+		if(!fill())
+			return EOF;
+		
+		return static_cast<unsigned char>(buffer[pos]);
+	}
+	
+	int xmltokenizer::get()
+	{
+		if(!fill())
+			return EOF;
+		
+		return static_cast<unsigned char>(buffer[pos++]);
+	}
+	
+	char xmltokenizer::expect()
+	{
+		const int c = get();
+		if(c == EOF)
+			xml_error();
+		
+		return static_cast<char>(c);
+	}
+	
+	void xmltokenizer::skip_whitespace()
+	{
+		while(is_xml_space(peek()))
+			pos++;
+	}
+	
+	void xmltokenizer::skip_until(const char* terminator)
+	{
+		// Compare the terminator with a window over the last characters read
+		const size_t n = strlen(terminator);
+		char window[4] = {0, 0, 0, 0};
+		
+		if(n >= sizeof(window))
+			xml_error();
+		
+		do
+		{
+			memmove(window, window + 1, n - 1);
+			window[n - 1] = expect();
+		}
+		while(memcmp(window, terminator, n) != 0);
+	}
+	
+	void xmltokenizer::read_name(std::string& str)
+	{
+		str.clear();
+		while(is_name_char(peek()))
+			str.push_back(static_cast<char>(get()));
+		
+		if(str.empty())
+			xml_error();
+	}
+	
+	void xmltokenizer::read_value(std::string& str, const char quote)
+	{
+		str.clear();
+		
+		for(char c = expect(); c != quote; c = expect())
+		{
+			if(c != '&')
+			{
+				str.push_back(c);
+				continue;
+			}
+			
+			char entity[12];
+			size_t n = 0;
+			for(c = expect(); c != ';'; c = expect())
+			{
+				if(n + 1 == sizeof(entity))
+					xml_error();
+				
+				entity[n++] = c;
+			}
+			entity[n] = '\0';
+			
+			if(strcmp(entity, "lt") == 0)
+				str.push_back('<');
+			else if(strcmp(entity, "gt") == 0)
+				str.push_back('>');
+			else if(strcmp(entity, "amp") == 0)
+				str.push_back('&');
+			else if(strcmp(entity, "quot") == 0)
+				str.push_back('"');
+			else if(strcmp(entity, "apos") == 0)
+				str.push_back('\'');
+			else if(entity[0] == '#')
+			{
+				const unsigned long code = entity[1] == 'x' ? strtoul(entity + 2, nullptr, 16) : strtoul(entity + 1, nullptr, 10);
+				if(code == 0 || code > 0x7f) // Names in traces are plain ASCII
+					xml_error();
+				
+				str.push_back(static_cast<char>(code));
+			}
+			else
+				xml_error();
+		}
+	}
+	
+	bool xmltokenizer::next(xmltokenizer::token_t& t)
+	{
+		if(pending_end)
+		{
+			pending_end = false;
+			t.kind = kind_e::end;
+			t.attribute_count = 0;
+			return true;
+		}
+		
+		for(;;)
+		{
+			// Skip text up to the next tag
+			int c;
+			while((c = get()) != '<')
+				if(c == EOF)
+					return false;
+			
+			c = peek();
+			
+			if(c == '?')
+			{
+				skip_until("?>");
+				continue;
+			}
+			
+			if(c == '!')
+			{
+				pos++;
+				
+				if(peek() == '-')
+					skip_until("-->");
+				else if(peek() == '[')
+					skip_until("]]>");
+				else
+					skip_until(">");
+				
+				continue;
+			}
+			
+			if(c == '/')
+			{
+				pos++;
+				t.kind = kind_e::end;
+				t.attribute_count = 0;
+				read_name(t.name);
+				skip_whitespace();
+				
+				if(get() != '>')
+					xml_error();
+				
+				return true;
+			}
+			
+			t.kind = kind_e::start;
+			t.attribute_count = 0;
+			read_name(t.name);
+			
+			for(;;)
+			{
+				skip_whitespace();
+				c = get();
+				
+				if(c == '>')
+					return true;
+				
+				if(c == '/')
+				{
+					if(get() != '>')
+						xml_error();
+					
+					pending_end = true;
+					return true;
+				}
+				
+				if(c == EOF)
+					xml_error();
+				
+				pos--;
+				
+				if(t.attribute_count == t.attributes.size())
+					t.attributes.emplace_back();
+				
+				auto& a = t.attributes[t.attribute_count++];
+				read_name(a.first);
+				skip_whitespace();
+				
+				if(get() != '=')
+					xml_error();
+				
+				skip_whitespace();
+				
+				const int quote = get();
+				if(quote != '"' && quote != '\'')
+					xml_error();
+				
+				read_value(a.second, static_cast<char>(quote));
+			}
+		}
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace uppaal2octopus
+{
+	/* A streaming, SAX-style tokenizer for XML. It reads the input in
+	 * fixed-size chunks and only yields element starts and ends, so memory
+	 * use does not depend on the size of the document. Text, comments,
+	 * processing instructions and declarations are skipped.
+	 *
+	 * Tokens reuse their buffers, so tokenizing does not allocate once the
+	 * buffers have grown to fit the largest element.
+	 */
+	class xmltokenizer
+	{
+	public:
+		enum class kind_e
+		{
+			start,
+			end
+		};
+		
+		struct token_t
+		{
+			kind_e kind;
+			std::string name;
+			
+			// Only the first attribute_count attributes are valid
+			std::vector<std::pair<std::string, std::string>> attributes;
+			size_t attribute_count;
+			
+			token_t();
+			
+			// The value of an attribute, or nullptr if it is absent.
+			const std::string* attribute(const char* name) const;
+		};
+	
+	private:
+		std::istream& is;
+		std::vector<char> buffer;
+		size_t pos, size;
+		
+		// Set after a self-closing element, whose end is yielded next
+		bool pending_end;
+		
+		xmltokenizer(xmltokenizer&) = delete;
+		void operator=(xmltokenizer&) = delete;
+		
+		bool fill();
+		int peek();
+		int get();
+		char expect();
+		
+		void skip_whitespace();
+		void skip_until(const char* terminator);
+		void read_name(std::string& str);
+		void read_value(std::string& str, const char quote);
+	
+	public:
+		xmltokenizer(std::istream& is);
+		
+		// Read the next element start or end; false at the end of the input.
+		bool next(token_t& t);
+	};
+}
@@ -24,209 +24,468 @@
 
 #include "xtrparser.hpp"
 
+#include "checkpoint.hpp"
 #include "path_finder.hpp"
 
 #include <algorithm>
+#include <exception>
 #include <sstream>
 #include <boost/optional.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 #include <boost/lexical_cast.hpp>
 
+#include <sys/stat.h>
+
 namespace uppaal2octopus
 {
+	xtrparser::xtrparser(const size_t threads, const filter& selection, const xtrparser::state_callback_t& on_state, const xtrparser::clocks_callback_t& on_clocks)
+	: pool(threads == 1 ? nullptr : std::make_shared<thread_pool>(threads))
+	, selection(selection)
+	, on_state(on_state)
+	, on_clocks(on_clocks)
+	{}
+	
+	xtrparser::trace_state_t::trace_state_t(const xtrparser::uppaalmodel_t& m, const filter& selection)
+	: clock(0)
+	, startClocks(m.processes.size(), 0)
+	, targets(m.processes.size(), boost::none)
+	, processes(m.processes.size(), false)
+	, locations(m.layout.size(), false)
+	{
+		for(size_t p = 0; p < m.processes.size(); p++)
+		{
+			processes[p] = selection.accepts(m.processes[p].name);
+			
+			// Only sources and targets of edges are ever output
+			if(processes[p])
+				for(const int e : m.processes[p].edges)
+					for(const int l : {m.edges[e].source, m.edges[e].target})
+						locations[l] = selection.accepts(m.processes[p].name, m.layout[l].name);
+		}
+	}
+	
+	void xtrparser::trace_state_t::save(std::ostream& os) const
+	{
+		checkpoint::write_uint(os, clock);
+		checkpoint::write_uint(os, startClocks.size());
+		
+		for(size_t p = 0; p < startClocks.size(); p++)
+		{
+			checkpoint::write_uint(os, startClocks[p]);
+			checkpoint::write_uint(os, targets[p] ? targets[p].get() + 1 : 0);
+		}
+	}
+	
+	void xtrparser::trace_state_t::restore(std::istream& is)
+	{
+		clock = static_cast<uint32_t>(checkpoint::read_uint(is));
+		
+		if(checkpoint::read_uint(is) != startClocks.size())
+			throw invalid_format("Checkpoint of a trace of another model");
+		
+		for(size_t p = 0; p < startClocks.size(); p++)
+		{
+			startClocks[p] = static_cast<uint32_t>(checkpoint::read_uint(is));
+			
+			const uint64_t target = checkpoint::read_uint(is);
+			if(target == 0)
+				targets[p] = boost::none;
+			else
+				targets[p] = static_cast<int>(target - 1);
+		}
+	}
+	
 	xtrparser::invalid_format::invalid_format(const std::string& arg) : runtime_error(arg)
 	{}
 	
-	bool xtrparser::read(FILE *file, char *str, size_t n) const
+	// A line or a field of a line of the intermediate format
+	struct if_text_t
+	{
+		const char* begin;
+		const char* end;
+		
+		bool empty() const
+		{
+			return begin == end;
+		}
+		
+		bool operator==(const char* str) const
+		{
+			const size_t n = strlen(str);
+			return static_cast<size_t>(end - begin) == n && memcmp(begin, str, n) == 0;
+		}
+	};
+	
+	// The next line at p that is not a comment, without its line break; false at the end
+	bool inline next_line(const char*& p, const char* end, if_text_t& line)
+	{
+		while(p != end)
+		{
+			const char* eol = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+			line = {p, eol != nullptr ? eol : end};
+			p = eol != nullptr ? eol + 1 : end;
+			
+			if(line.empty() || *line.begin != '#')
+				return true;
+		}
+		
+		return false;
+	}
+	
+	/* The lines of the section at p, up to a line that is empty or starts
+	 * with whitespace, which ends the section.
+	 */
+	void inline section_lines(const char*& p, const char* end, std::vector<if_text_t>& lines)
+	{
+		lines.clear();
+		
+		if_text_t line;
+		while(next_line(p, end, line) && !line.empty() && !isspace(static_cast<unsigned char>(*line.begin)))
+			lines.push_back(line);
+	}
+	
+	// Split at the first n - 1 colons, the last field holding the rest; returns the number of fields.
+	size_t inline split(const if_text_t& text, if_text_t* fields, const size_t n)
+	{
+		size_t count = 0;
+		const char* begin = text.begin;
+		
+		while(count + 1 < n)
+		{
+			const char* colon = static_cast<const char*>(memchr(begin, ':', static_cast<size_t>(text.end - begin)));
+			if(colon == nullptr)
+				break;
+			
+			fields[count++] = {begin, colon};
+			begin = colon + 1;
+		}
+		
+		fields[count++] = {begin, text.end};
+		return count;
+	}
+	
+	// An integer at the start of text after whitespace, advancing past it.
+	bool inline parse_int(if_text_t& text, int& x)
 	{
-		do
+		const char* p = text.begin;
+		while(p != text.end && isspace(static_cast<unsigned char>(*p)))
+			p++;
+		
+		const bool negative = p != text.end && *p == '-';
+		if(negative || (p != text.end && *p == '+'))
+			p++;
+		
+		const char* digits = p;
+		long long value = 0;
+		for(; p != text.end && *p >= '0' && *p <= '9'; p++)
 		{
-			if(fgets(str, n, file) == NULL)
+			value = value * 10 + (*p - '0');
+			if(value > INT_MAX + 1LL)
 				return false;
 		}
-		while(str[0] == '#');
+		
+		if(p == digits || (!negative && value > INT_MAX))
+			return false;
+		
+		x = static_cast<int>(negative ? -value : value);
+		text.begin = p;
 		return true;
 	}
 	
-	void xtrparser::loadIF(xtrparser::uppaalmodel_t& m, FILE *file) const
+	// Idem, for a field holding just the integer, possibly followed by whitespace.
+	bool inline parse_int(const if_text_t& field, int& x)
 	{
-		char str[255];
-		char section[16];
-		char name[32];
-		int index;
-
-		while(fscanf(file, "%15s\n", section) == 1)
+		if_text_t rest = field;
+		if(!parse_int(rest, x))
+			return false;
+		
+		while(rest.begin != rest.end && isspace(static_cast<unsigned char>(*rest.begin)))
+			rest.begin++;
+		
+		return rest.empty();
+	}
+	
+	// The first whitespace separated word of a field, if any.
+	bool inline parse_name(const if_text_t& field, std::string& name)
+	{
+		const char* p = field.begin;
+		while(p != field.end && isspace(static_cast<unsigned char>(*p)))
+			p++;
+		
+		const char* q = p;
+		while(q != field.end && !isspace(static_cast<unsigned char>(*q)))
+			q++;
+		
+		name.assign(p, q);
+		return p != q;
+	}
+	
+	// The text after the given number of colons, without surrounding whitespace.
+	bool inline parse_after(const if_text_t& line, const size_t colons, if_text_t& text)
+	{
+		if_text_t fields[4] = {};
+		if(split(line, fields, colons + 1) != colons + 1)
+			return false;
+		
+		const char* p = fields[colons].begin;
+		const char* q = fields[colons].end;
+		
+		while(p != q && isspace(static_cast<unsigned char>(*p)))
+			p++;
+		while(q != p && isspace(static_cast<unsigned char>(q[-1])))
+			q--;
+		
+		text = {p, q};
+		return true;
+	}
+	
+	// A perfect hash of the type keywords of layout cells: their length and last character
+	size_t inline keyword_hash(const if_text_t& keyword)
+	{
+		return keyword.empty() ? 0 : (static_cast<size_t>(keyword.end - keyword.begin) * 3 + static_cast<unsigned char>(keyword.end[-1])) & 15;
+	}
+	
+	void xtrparser::loadIF(xtrparser::uppaalmodel_t& m, const char* data, const size_t size) const
+	{
+		struct keyword_t
 		{
-			if(strcmp(section, "layout") == 0)
+			const char* name;
+			type_t type;
+		};
+		
+		static const std::vector<keyword_t> keywords = [] {
+			const keyword_t all[] = {{"clock", CLOCK}, {"const", CONST}, {"var", VAR}, {"meta", META}, {"location", LOCATION}, {"static", FIXED}, {"cost", COST}};
+			std::vector<keyword_t> table(16, keyword_t{nullptr, CONST});
+			
+			for(const keyword_t& k : all)
+				table[keyword_hash({k.name, k.name + strlen(k.name)})] = k;
+			
+			return table;
+		}();
+		
+		// Parse lines on the decoding threads, in chunks of consecutive lines
+		const auto parse_lines = [this](const std::vector<if_text_t>& lines, const std::function<void(size_t)>& parse) {
+			static const size_t chunk_size = 4096;
+			
+			if(!pool || lines.size() <= chunk_size)
+			{
+				for(size_t i = 0; i < lines.size(); i++)
+					parse(i);
+				
+				return;
+			}
+			
+			pool->parallel_for((lines.size() + chunk_size - 1) / chunk_size, [&](const size_t chunk) {
+				const size_t last = std::min(lines.size(), (chunk + 1) * chunk_size);
+				for(size_t i = chunk * chunk_size; i < last; i++)
+					parse(i);
+			});
+		};
+		
+		const char* p = data;
+		const char* const end = data + size;
+		
+		std::vector<if_text_t> lines;
+		if_text_t fields[7] = {};
+		
+		if_text_t header;
+		while(next_line(p, end, header))
+		{
+			// Sections are separated by blank lines
+			while(header.begin != header.end && isspace(static_cast<unsigned char>(*header.begin)))
+				header.begin++;
+			while(header.end != header.begin && isspace(static_cast<unsigned char>(header.end[-1])))
+				header.end--;
+			
+			if(header.empty())
+				continue;
+			
+			section_lines(p, end, lines);
+			
+			if(header == "layout")
 			{
-				while(read(file, str, 255) && !isspace(str[0]))
+				m.layout.reserve(m.layout.size() + lines.size());
+				for(const if_text_t& line : lines)
 				{
-					char s[5];
 					cell_t cell;
-
-					if(sscanf(str, "%d:clock:%d:%31s", &index,
-							&cell.clock.nr, name) == 3)
-					{
-						cell.type = CLOCK;
-						cell.name = name;
-						m.clocks.push_back(name);
-					}
-					else if(sscanf(str, "%d:const:%d", &index,
-							&cell.value) == 2)
-					{
-						cell.type = CONST;
-					}
-					else if(sscanf(str, "%d:var:%d:%d:%d:%d:%31s", &index,
-							&cell.var.min, &cell.var.max, &cell.var.init,
-							&cell.var.nr, name) == 6)
-					{
-						cell.type = VAR;
-						cell.name = name;
-						m.variables.push_back(name);
-					}
-					else if(sscanf(str, "%d:meta:%d:%d:%d:%d:%31s", &index,
-							&cell.meta.min, &cell.meta.max, &cell.meta.init,
-							&cell.meta.nr, name) == 6)
-					{
-						cell.type = META;
-						cell.name = name;
-						m.variables.push_back(name);
-					}
-					else if(sscanf(str, "%d:location::%31s", &index, name) == 2)
-					{
-						cell.type = LOCATION;
-						cell.location.flags = NONE;
-						cell.name = name;
-					}
-					else if(sscanf(str, "%d:location:committed:%31s", &index, name) == 2)
-					{
-						cell.type = LOCATION;
-						cell.location.flags = COMMITTED;
-						cell.name = name;
-					}
-					else if(sscanf(str, "%d:location:urgent:%31s", &index, name) == 2)
-					{
-						cell.type = LOCATION;
-						cell.location.flags = URGENT;
-						cell.name = name;
-					}
-					else if(sscanf(str, "%d:static:%d:%d:%31s", &index,
-							&cell.fixed.min, &cell.fixed.max,
-							name) == 4)
-					{
-						cell.type = FIXED;
-						cell.name = name;
-					}
-					else if(sscanf(str, "%d:%5s", &index, s) == 2
-							&& strcmp(s, "cost") == 0)
-					{
-						cell.type = COST;
-					}
-					else
+					int index;
+					
+					const size_t count = split(line, fields, 3);
+					if(count < 2 || !parse_int(fields[0], index))
+						throw invalid_format(std::string(line.begin, line.end));
+					
+					const keyword_t& k = keywords[keyword_hash(fields[1])];
+					if(k.name == nullptr || !(fields[1] == k.name))
+						throw invalid_format(std::string(line.begin, line.end));
+					
+					// The fields after the type, split further by type
+					const if_text_t rest = count == 3 ? fields[2] : if_text_t{line.end, line.end};
+					bool valid = count == 3;
+					
+					cell.type = k.type;
+					switch(k.type)
 					{
-						throw invalid_format(str);
+					case CLOCK:
+						valid = valid && split(rest, fields, 2) == 2 && parse_int(fields[0], cell.clock.nr) && parse_name(fields[1], cell.name);
+						if(valid)
+							m.clocks.push_back(cell.name);
+						break;
+					case CONST:
+						valid = valid && parse_int(rest, cell.value);
+						break;
+					case VAR:
+					case META:
+						valid = valid && split(rest, fields, 5) == 5
+							&& parse_int(fields[0], cell.var.min) && parse_int(fields[1], cell.var.max)
+							&& parse_int(fields[2], cell.var.init) && parse_int(fields[3], cell.var.nr)
+							&& parse_name(fields[4], cell.name);
+						if(valid)
+							m.variables.push_back(cell.name);
+						break;
+					case LOCATION:
+						valid = valid && split(rest, fields, 2) == 2 && parse_name(fields[1], cell.name);
+						if(!valid)
+							break;
+						
+						if(fields[0].empty())
+							cell.location.flags = NONE;
+						else if(fields[0] == "committed")
+							cell.location.flags = COMMITTED;
+						else if(fields[0] == "urgent")
+							cell.location.flags = URGENT;
+						else
+							valid = false;
+						break;
+					case FIXED:
+						valid = valid && split(rest, fields, 3) == 3
+							&& parse_int(fields[0], cell.fixed.min) && parse_int(fields[1], cell.fixed.max)
+							&& parse_name(fields[2], cell.name);
+						break;
+					case COST:
+						valid = true;
+						break;
 					}
-
+					
+					if(!valid)
+						throw invalid_format(std::string(line.begin, line.end));
+					
 					m.layout.push_back(cell);
 				}
 			}
-			else if(strcmp(section, "instructions") == 0)
+			else if(header == "instructions")
 			{
-				while(read(file, str, 255) && !isspace(str[0]))
+				for(const if_text_t& line : lines)
 				{
-					int address;
-					int values[4];
-					int cnt = sscanf(
-							  str, "%d:%d%d%d%d", &address,
-							  values + 0, values + 1, values + 2, values + 4);
-					if(cnt < 2)
+					int address, value;
+					if(split(line, fields, 2) != 2 || !parse_int(fields[0], address))
+						throw invalid_format("In instruction section");
+					
+					if_text_t values = fields[1];
+					size_t count = 0;
+					for(; parse_int(values, value); count++)
+						m.instructions.push_back(value);
+					
+					if(count == 0)
 						throw invalid_format("In instruction section");
-
-					for(int i = 0; i < cnt; i++)
-						m.instructions.push_back(values[i]);
 				}
 			}
-			else if(strcmp(section, "processes") == 0)
+			else if(header == "processes")
 			{
-				while(read(file, str, 255) && !isspace(str[0]))
+				for(const if_text_t& line : lines)
 				{
+					int index;
 					process_t process;
-					if(sscanf(str, "%d:%d:%31s", &index, &process.initial, name) != 3)
+					
+					if(split(line, fields, 3) != 3 || !parse_int(fields[0], index) || !parse_int(fields[1], process.initial) || !parse_name(fields[2], process.name))
 						throw invalid_format("In process section");
-					process.name = name;
+					
 					m.processes.push_back(process);
 				}
 			}
-			else if(strcmp(section, "locations") == 0)
+			else if(header == "locations")
 			{
-				while(read(file, str, 255) && !isspace(str[0]))
+				for(const if_text_t& line : lines)
 				{
-					int index;
-					int process;
-					int invariant;
-
-					if(sscanf(str, "%d:%d:%d", &index, &process, &invariant) != 3)
+					int index, process, invariant;
+					
+					if(split(line, fields, 3) != 3 || !parse_int(fields[0], index) || !parse_int(fields[1], process) || !parse_int(fields[2], invariant))
 						throw invalid_format("In location section");
-
+					
+					if(index < 0 || static_cast<size_t>(index) >= m.layout.size() || process < 0 || static_cast<size_t>(process) >= m.processes.size())
+						throw invalid_format("In location section");
+					
 					if(m.layout[index].type != type_t::LOCATION)
 						workaround(m, index);
-
+					
 					m.layout[index].location.process = process;
 					m.layout[index].location.invariant = invariant;
 					m.processes[process].locations.push_back(index);
 				}
 			}
-			else if(strcmp(section, "edges") == 0)
+			else if(header == "edges")
 			{
-				while(read(file, str, 255) && !isspace(str[0]))
+				std::vector<edge_t> edges(lines.size());
+				
+				parse_lines(lines, [&](const size_t i) {
+					if_text_t f[6] = {};
+					edge_t& edge = edges[i];
+					
+					if(split(lines[i], f, 6) != 6
+						|| !parse_int(f[0], edge.process) || !parse_int(f[1], edge.source)
+						|| !parse_int(f[2], edge.target) || !parse_int(f[3], edge.guard)
+						|| !parse_int(f[4], edge.sync) || !parse_int(f[5], edge.update))
+						throw invalid_format("In edge section");
+				});
+				
+				m.edges.reserve(m.edges.size() + edges.size());
+				for(const edge_t& edge : edges)
 				{
-					edge_t edge;
-
-					if(sscanf(str, "%d:%d:%d:%d:%d:%d", &edge.process,
-							&edge.source, &edge.target,
-							&edge.guard, &edge.sync, &edge.update) != 6)
+					if(edge.process < 0 || static_cast<size_t>(edge.process) >= m.processes.size()
+						|| edge.source < 0 || static_cast<size_t>(edge.source) >= m.layout.size()
+						|| edge.target < 0 || static_cast<size_t>(edge.target) >= m.layout.size())
 						throw invalid_format("In edge section");
-
+					
 					if(m.layout[edge.source].type != type_t::LOCATION)
 						workaround(m, edge.source);
-						
+					
 					if(m.layout[edge.target].type != type_t::LOCATION)
 						workaround(m, edge.target);
-
+					
 					m.processes[edge.process].edges.push_back(m.edges.size());
 					m.edges.push_back(edge);
 				}
 			}
-			else if(strcmp(section, "expressions") == 0)
+			else if(header == "expressions")
 			{
-				while(read(file, str, 255) && !isspace(str[0]))
-				{
-					if(sscanf(str, "%d", &index) != 1)
-						throw invalid_format("In expression section");
-
-					/* Find expression string (after the third colon).
-					 */
-					char *s = str;
-					int cnt = 3;
-					while(cnt && *s)
-					{
-						cnt -= (*s == ':');
-						s++;
-					}
+				std::vector<std::pair<int, if_text_t>> expressions(lines.size());
 				
-					if(cnt)
+				parse_lines(lines, [&](const size_t i) {
+					// The index, then the expression after the third colon
+					if_text_t index = lines[i];
+					if(!parse_int(index, expressions[i].first) || expressions[i].first < 0 || !parse_after(lines[i], 3, expressions[i].second))
 						throw invalid_format("In expression section");
-
-					/* Trim white space.
-					 */
-					while(*s && isspace(*s))
-						s++;
-
-					char *t = s + strlen(s) - 1;
-					while(t >= s && isspace(*t))
-						t--;
-
-					t[1] = '\0';
-					m.expressions[index] = s;
+				});
+				
+				const size_t offset = m.expressions.size();
+				m.expressions.reserve(offset + expressions.size());
+				for(const auto& e : expressions)
+					m.expressions.emplace_back(e.first, boost::string_ref(e.second.begin, static_cast<size_t>(e.second.end - e.second.begin)));
+				
+				const auto by_id = [](const std::pair<int, boost::string_ref>& a, const std::pair<int, boost::string_ref>& b) {
+					return a.first < b.first;
+				};
+				
+				// Ids are normally listed in order; a repeated id has the expression listed last
+				if(std::adjacent_find(m.expressions.begin(), m.expressions.end(), [](const std::pair<int, boost::string_ref>& a, const std::pair<int, boost::string_ref>& b) {
+					return a.first >= b.first;
+				}) != m.expressions.end())
+				{
+					std::stable_sort(m.expressions.begin(), m.expressions.end(), by_id);
+					
+					const auto first = std::unique(m.expressions.rbegin(), m.expressions.rend(), [](const std::pair<int, boost::string_ref>& a, const std::pair<int, boost::string_ref>& b) {
+						return a.first == b.first;
+					}).base();
+					m.expressions.erase(m.expressions.begin(), first);
 				}
 			}
 			else
@@ -234,65 +493,152 @@ namespace uppaal2octopus
 		}
 	}
 
-	xtrparser::State::State(const uppaalmodel_t& m, FILE *file)
+	boost::string_ref xtrparser::uppaalmodel_t::expression(const int id) const
+	{
+		const auto i = std::lower_bound(expressions.begin(), expressions.end(), id, [](const std::pair<int, boost::string_ref>& e, const int id) {
+			return e.first < id;
+		});
+		
+		return i != expressions.end() && i->first == id ? i->second : boost::string_ref();
+	}
+	
+	xtrparser::State::State(const uppaalmodel_t& m, xtrscanner& scanner)
+	: locations(m.processes.size())
+	, integers(m.variables.size())
+	, constraints()
 	{
-		allocate(m);
-
 		/* Read locations.
 		 */
 		for(size_t i = 0; i < m.processes.size(); i++)
-			fscanf(file, "%d\n", &getLocation(i));
+			scanner.try_read_int(getLocation(i));
 
-		fscanf(file, ".\n");
+		scanner.separator();
 
 		/* Read DBM.
 		 */
+		// Whether constraint c comes before the pair (i, j) in row order
+		const auto before = [](const constraint_t& c, const int i, const int j) {
+			return c.i < i || (c.i == i && c.j < j);
+		};
+		
 		int i, j, bnd;
-		while(fscanf(file, "%d\n%d\n%d\n.\n", &i, &j, &bnd) == 3)
+		bool ordered = true;
+		while(scanner.try_read_int(i))
+		{
+			if(!scanner.try_read_int(j) || !scanner.try_read_int(bnd))
+				throw invalid_format("In DBM of state");
+
+			if(i < 0 || j < 0 || static_cast<size_t>(i) >= m.clocks.size() || static_cast<size_t>(j) >= m.clocks.size())
+				throw invalid_format("Unknown clock in DBM of state");
+
+			if(i != j)
+			{
+				// Infinite bounds are kept until the end, they may override an earlier constraint
+				if(!constraints.empty() && !before(constraints.back(), i, j))
+					ordered = false;
+				
+				const bound_t b = { bnd >> 1, static_cast<bool>(bnd & 1) };
+				constraints.push_back({i, j, b});
+			}
+
+			scanner.skip_whitespace();
+			scanner.try_consume('.');
+		}
+		scanner.separator();
+		
+		/* Like a dense DBM, the last constraint listed for a pair wins. Blocks
+		 * are normally in row order, so this only sorts when they are not.
+		 */
+		if(!ordered)
 		{
-			getConstraint(m, i, j).value = bnd >> 1;
-			getConstraint(m, i, j).strict = bnd & 1;
+			std::stable_sort(constraints.begin(), constraints.end(), [&](const constraint_t& a, const constraint_t& b) {
+				return before(a, b.i, b.j);
+			});
+			
+			const auto last = std::unique(constraints.rbegin(), constraints.rend(), [](const constraint_t& a, const constraint_t& b) {
+				return a.i == b.i && a.j == b.j;
+			});
+			constraints.erase(constraints.begin(), last.base());
 		}
-		fscanf(file, ".\n");
+		
+		constraints.erase(std::remove_if(constraints.begin(), constraints.end(), [](const constraint_t& c) {
+			return c.bound.value == infinity.value;
+		}), constraints.end());
 
 		/* Read integers.
 		 */
 		for(size_t i = 0; i < m.variables.size(); i++)
-		{
-			fscanf(file, "%d\n", &getVariable(i));
-		}
-		fscanf(file, ".\n");
+			scanner.try_read_int(getVariable(i));
+
+		scanner.separator();
 	}
 
-	void xtrparser::State::allocate(const uppaalmodel_t& m)
+	void xtrparser::State::skip(const uppaalmodel_t& m, xtrscanner& scanner)
 	{
-		const auto infinity_tmp = xtrparser::infinity;
-		const auto zero_tmp = xtrparser::zero;
-	
-		/* Allocate.
-		 */
-		locations = std::vector<int>(m.processes.size());
-		integers = std::vector<int>(m.variables.size());
-		dbm = std::vector<bound_t>(m.clocks.size() * m.clocks.size(), infinity_tmp);
+		int x;
 		
-		/* Set diagonal and lower bounds to zero.
-		 */
-		for(size_t i = 0; i < m.clocks.size(); i++)
+		for(size_t i = 0; i < m.processes.size(); i++)
+			scanner.try_read_int(x);
+
+		scanner.separator();
+
+		while(scanner.try_read_int(x))
 		{
-		//	getConstraint(m, 0, i) = zero_tmp;
-			getConstraint(m, i, i) = zero_tmp;
+			if(!scanner.try_read_int(x) || !scanner.try_read_int(x))
+				throw invalid_format("In DBM of state");
+
+			scanner.skip_whitespace();
+			scanner.try_consume('.');
 		}
+		scanner.separator();
+
+		for(size_t i = 0; i < m.variables.size(); i++)
+			scanner.try_read_int(x);
+
+		scanner.separator();
+	}
+
+	xtrparser::bound_t xtrparser::State::getConstraint(int i, int j) const
+	{
+		for(const constraint_t& c : constraints)
+			if(c.i == i && c.j == j)
+				return c.bound;
+		
+		if(i == j)
+			return xtrparser::zero;
+		
+		return xtrparser::infinity;
 	}
 	
-	xtrparser::Transition::Transition(const uppaalmodel_t& m, FILE *file)
+	xtrparser::Transition::Transition(const uppaalmodel_t& m, xtrscanner& scanner)
 	{
 		edges = std::vector<int>(m.processes.size(), -1);
 
 		int process, edge;
-		while(fscanf(file, "%d %d.\n", &process, &edge) == 2)
+		while(scanner.try_read_int(process))
+		{
+			if(!scanner.try_read_int(edge))
+				throw invalid_format("In transition");
+
 			edges[process] = edge - 1;
+			scanner.try_consume('.');
+		}
+
+		scanner.separator();
+	}
+	
+	void xtrparser::Transition::skip(xtrscanner& scanner)
+	{
+		int x;
+		while(scanner.try_read_int(x))
+		{
+			if(!scanner.try_read_int(x))
+				throw invalid_format("In transition");
+
+			scanner.try_consume('.');
+		}
 
-		fscanf(file, ".\n");
+		scanner.separator();
 	}
 	
 	size_t xtrparser::findClock(const xtrparser::uppaalmodel_t& m, const std::string str) const
@@ -315,123 +661,396 @@ namespace uppaal2octopus
 		const size_t c_i = findClock(m, "c");
 		
 		path_finder<size_t>::edges_t edges;
+		edges.reserve(s.getConstraints().size());
 		
-		for(size_t i = 0; i < m.clocks.size(); i++) 
-			for(size_t j = 0; j < m.clocks.size(); j++) 
-				if(i != j && s.getConstraint(m, i, j).value != infinity.value)
-					edges.emplace_back(i, j);
+		for(const constraint_t& c : s.getConstraints())
+			edges.emplace_back(c.i, c.j);
 		
 		const auto trace = path_finder<size_t>::search(edges, t0_i, c_i);
 		
 		int result = 0;
 		for(const auto& e : trace)
-			result -= s.getConstraint(m, e.first, e.second).value;
+			result -= s.getConstraint(e.first, e.second).value;
 		
 		return result;
 	}
 	
-	void xtrparser::loadTrace(const xtrparser::uppaalmodel_t& m, FILE *file, const xtrparser::callback_t& f) const
+	void xtrparser::getClocks(const xtrparser::uppaalmodel_t& m, const xtrparser::State& s, dbm& d, std::vector<int>& result) const
 	{
-		std::vector<uint32_t> startClocks(m.processes.size(), 0);
-		std::vector<boost::optional<int>> targets(m.processes.size(), boost::none);
+		d.clear();
+		for(const constraint_t& c : s.getConstraints())
+			d.set(static_cast<size_t>(c.i), static_cast<size_t>(c.j), c.bound.value);
 		
-		State state(m, file);
-		uint32_t clock = static_cast<uint32_t>(getClock(m, state));
+		d.lower_bounds(findClock(m, "t(0)"), result);
+	}
+	
+	void xtrparser::loadTrace(const xtrparser::uppaalmodel_t& m, xtrscanner& scanner, const xtrparser::callback_t& f, const xtrparser::position_callback_t& on_position) const
+	{
+		trace_state_t t(m, selection);
 		
-		for(;;)
 		{
-			int c;
+			const State state(m, scanner);
+			t.clock = static_cast<uint32_t>(getClock(m, state));
 			
-			// Skip white space.
-			do
+			if(on_state)
+				on_state(t.clock, m.variables, state.getVariables());
+			
+			if(on_clocks)
 			{
-				c = fgetc(file);
+				dbm d(m.clocks.size());
+				std::vector<int> clocks;
+				getClocks(m, state, d, clocks);
+				on_clocks(t.clock, m.clocks, clocks);
 			}
-			while(isspace(c));
+		}
+		
+		resumeTrace(m, scanner, t, f, on_position);
+	}
+	
+	void xtrparser::resumeTrace(const xtrparser::uppaalmodel_t& m, xtrscanner& scanner, xtrparser::trace_state_t& t, const xtrparser::callback_t& f, const xtrparser::position_callback_t& on_position) const
+	{
+		if(!pool)
+			loadStates(m, scanner, t, f, on_position);
+		else
+			loadStatesParallel(m, scanner, t, f, on_position);
+		
+		finish(m, t, f);
+	}
+	
+	void xtrparser::loadStates(const xtrparser::uppaalmodel_t& m, xtrscanner& scanner, xtrparser::trace_state_t& t, const xtrparser::callback_t& f, const xtrparser::position_callback_t& on_position) const
+	{
+		static const size_t position_interval = 4096;
+		
+		dbm d(on_clocks ? m.clocks.size() : 0);
+		std::vector<int> clocks;
+		
+		for(size_t n = 1;; n++)
+		{
+			// Skip white space.
+			scanner.skip_whitespace();
 
-			// A dot terminates the trace.
-			if(c == '.')
+			// A dot (or the end of the file) terminates the trace.
+			if(scanner.eof() || scanner.try_consume('.'))
 				break;
 
-			// Put the character back into the stream.
-			std::ungetc(c, file);
-
 			// Read a state and a transition.
-			state = State(m, file);
-			clock = static_cast<uint32_t>(getClock(m, state));
+			const State state(m, scanner);
+			const uint32_t clock = static_cast<uint32_t>(getClock(m, state));
 			
-			Transition transition(m, file);
-
-			//jobId, pageNumber, scenario, resource, eventId, startEnd, timeStamp, label
+			const Transition transition(m, scanner);
+			
+			if(on_state)
+				on_state(clock, m.variables, state.getVariables());
 			
-			for(uint32_t p = 0; p < m.processes.size(); p++)
+			if(on_clocks)
 			{
-				const int idx = transition.getEdge(p);
-				
-				if(idx == -1)
-					continue;
-				
-				const uint32_t edge = m.processes[p].edges[idx];
-				
-				targets[p] = m.edges[edge].target;
-				
-				if(clock - startClocks[p] > 0)
+				getClocks(m, state, d, clocks);
+				on_clocks(clock, m.clocks, clocks);
+			}
+			
+			advance(m, t, transition, clock, f);
+			
+			if(on_position && n % position_interval == 0)
+				on_position(scanner.position(), t);
+		}
+	}
+	
+	void xtrparser::loadStatesParallel(const xtrparser::uppaalmodel_t& m, xtrscanner& scanner, xtrparser::trace_state_t& t, const xtrparser::callback_t& f, const xtrparser::position_callback_t& on_position) const
+	{
+		struct step_t
+		{
+			uint32_t clock;
+			std::vector<int> variables, clocks;
+			boost::optional<Transition> transition;
+			std::exception_ptr error;
+			
+			step_t()
+			: clock(0)
+			, variables()
+			, clocks()
+			, transition()
+			, error()
+			{}
+		};
+		
+		const size_t batch_size = pool->size() * 1024;
+		
+		std::vector<const char*> offsets;
+		std::vector<step_t> steps; // Kept over batches, so that their clocks are not allocated again
+		std::vector<dbm> scratch(on_clocks ? pool->size() : 0, dbm(m.clocks.size())); // By stripe
+		
+		bool done = false;
+		while(!done)
+		{
+			/* Find the start of each state block sequentially; this only
+			 * skims over the integers, which is cheap compared to decoding.
+			 */
+			offsets.clear();
+			std::exception_ptr error;
+			
+			try
+			{
+				while(offsets.size() < batch_size)
 				{
-					location_t loc = std::make_pair(m.processes.at(p).name, m.layout.at(m.edges[edge].source).name);
+					scanner.skip_whitespace();
+					
+					if(scanner.eof() || scanner.try_consume('.'))
+					{
+						done = true;
+						break;
+					}
+					
+					const char* offset = scanner.position();
+					State::skip(m, scanner);
+					Transition::skip(scanner);
+					offsets.push_back(offset);
+				}
+			} catch(...)
+			{
+				error = std::current_exception();
+				done = true;
+			}
+			
+			// Decode the blocks and compute their clocks on the pool.
+			steps.resize(offsets.size());
+			
+			pool->parallel_for_stripes(offsets.size(), [&](const size_t i, const size_t stripe) {
+				steps[i].error = nullptr;
 				
-					f(loc, startClocks[p], startend_e::start);
-					f(loc, clock, startend_e::end);
+				try
+				{
+					xtrscanner s = scanner.seek(offsets[i]);
+					
+					const State state(m, s);
+					steps[i].clock = static_cast<uint32_t>(getClock(m, state));
+					
+					if(on_state)
+						steps[i].variables = state.getVariables();
+					
+					if(on_clocks)
+						getClocks(m, state, scratch[stripe], steps[i].clocks);
+					
+					steps[i].transition = Transition(m, s);
+				} catch(...)
+				{
+					steps[i].error = std::current_exception();
 				}
+			});
+			
+			// Stitch the intervals in trace order.
+			for(const step_t& step : steps)
+			{
+				if(step.error)
+					std::rethrow_exception(step.error);
+				
+				if(on_state)
+					on_state(step.clock, m.variables, step.variables);
 				
-				startClocks[p] = clock;
+				if(on_clocks)
+					on_clocks(step.clock, m.clocks, step.clocks);
+				
+				advance(m, t, step.transition.get(), step.clock, f);
 			}
+			
+			if(error)
+				std::rethrow_exception(error);
+			
+			// The scanner is past the batch just stitched
+			if(on_position && !done)
+				on_position(scanner.position(), t);
 		}
+	}
+	
+	void xtrparser::advance(const xtrparser::uppaalmodel_t& m, xtrparser::trace_state_t& t, const xtrparser::Transition& transition, const uint32_t clock, const xtrparser::callback_t& f) const
+	{
+		t.clock = clock;
+		
+		//jobId, pageNumber, scenario, resource, eventId, startEnd, timeStamp, label
 		
+		for(uint32_t p = 0; p < m.processes.size(); p++)
+		{
+			const int idx = transition.getEdge(p);
+			
+			if(idx == -1 || !t.processes[p])
+				continue;
+			
+			const uint32_t edge = m.processes[p].edges[idx];
+			
+			t.targets[p] = m.edges[edge].target;
+			
+			if(clock - t.startClocks[p] > 0 && t.locations[m.edges[edge].source])
+			{
+				const location_t loc(m.processes.at(p).name, m.layout.at(m.edges[edge].source).name);
+			
+				f(loc, t.startClocks[p], startend_e::start);
+				f(loc, clock, startend_e::end);
+			}
+			
+			t.startClocks[p] = clock;
+		}
+	}
+	
+	void xtrparser::finish(const xtrparser::uppaalmodel_t& m, const xtrparser::trace_state_t& t, const xtrparser::callback_t& f) const
+	{
 		// Output all end-states
 		for(uint32_t p = 0; p < m.processes.size(); p++)
 		{
-			if(!targets[p])
+			if(!t.targets[p])
 				continue;
 			
-			if(clock - startClocks[p] == 0)
+			if(t.clock - t.startClocks[p] == 0 || !t.locations[t.targets[p].get()])
 				continue;
 			
-			location_t loc = std::make_pair(m.processes.at(p).name, m.layout.at(targets[p].get()).name);
+			const location_t loc(m.processes.at(p).name, m.layout.at(t.targets[p].get()).name);
 			
-			f(loc, startClocks[p], startend_e::start);
-			f(loc, clock, startend_e::end);
+			f(loc, t.startClocks[p], startend_e::start);
+			f(loc, t.clock, startend_e::end);
 		}
 	}
 	
+	xtrparser::stepper::stepper(const xtrparser& parser, const xtrparser::model_t& m, const char* data, const size_t size)
+	: parser(parser)
+	, m(m)
+	, scanner(data, data + size)
+	, t(m, parser.selection)
+	, phase(phase_e::initial)
+	, clock_bounds(parser.on_clocks ? m.clocks.size() : 0)
+	, clocks()
+	{}
+	
+	bool xtrparser::stepper::next(const xtrparser::callback_t& f)
+	{
+		switch(phase)
+		{
+		case phase_e::initial:
+			{
+				const State state(m, scanner);
+				t.clock = static_cast<uint32_t>(parser.getClock(m, state));
+				phase = phase_e::states;
+				
+				if(parser.on_state)
+					parser.on_state(t.clock, m.variables, state.getVariables());
+				
+				if(parser.on_clocks)
+				{
+					parser.getClocks(m, state, clock_bounds, clocks);
+					parser.on_clocks(t.clock, m.clocks, clocks);
+				}
+			}
+			return true;
+		case phase_e::states:
+			// A dot (or the end of the file) terminates the trace.
+			scanner.skip_whitespace();
+			if(scanner.eof() || scanner.try_consume('.'))
+			{
+				parser.finish(m, t, f);
+				phase = phase_e::done;
+			}
+			else
+			{
+				const State state(m, scanner);
+				const uint32_t clock = static_cast<uint32_t>(parser.getClock(m, state));
+				
+				const Transition transition(m, scanner);
+				
+				if(parser.on_state)
+					parser.on_state(clock, m.variables, state.getVariables());
+				
+				if(parser.on_clocks)
+				{
+					parser.getClocks(m, state, clock_bounds, clocks);
+					parser.on_clocks(clock, m.clocks, clocks);
+				}
+				
+				parser.advance(m, t, transition, clock, f);
+			}
+			return true;
+		case phase_e::done:
+			break;
+		}
+		
+		return false;
+	}
+	
 	void xtrparser::workaround(uppaalmodel_t& m, int l) const
 	{
 		std::cerr << "Inconsistent model: unexpected type " << m.layout[l].type << " for cell " << l << " (workaround by setting to location)" << std::endl;
 		
 		m.layout[l].type = LOCATION;
 		m.layout[l].name = "restored_cell_";
-		m.layout[l].name.append(boost::lexical_cast<std::string>(index));
+		m.layout[l].name.append(boost::lexical_cast<std::string>(l));
+	}
+	
+	void xtrparser::load(xtrparser::model_t& m, const std::string model) const
+	{
+		struct stat st;
+		if(stat(model.c_str(), &st) != 0)
+			throw std::runtime_error(std::string("Cannot open model ") + model);
+		
+		// An empty file cannot be mapped, and has nothing to refer to
+		if(st.st_size == 0)
+			return loadIF(m, nullptr, 0);
+		
+		try
+		{
+			m.file.open(model);
+		} catch(const std::exception&)
+		{
+			throw std::runtime_error(std::string("Cannot open model ") + model);
+		}
+		
+		loadIF(m, m.file.data(), m.file.size());
+	}
+	
+	void xtrparser::load(xtrparser::model_t& m, const char* data, const size_t size) const
+	{
+		// The expressions refer to the text, which the caller may not keep
+		m.copy.assign(data, size);
+		loadIF(m, m.copy.data(), m.copy.size());
+	}
+	
+	void xtrparser::parse(const xtrparser::model_t& m, const char* data, const size_t size, const xtrparser::callback_t& f) const
+	{
+		xtrscanner scanner(data, data + size);
+		loadTrace(m, scanner, f, nullptr);
+	}
+	
+	void xtrparser::parse(const xtrparser::model_t& m, const char* data, const size_t size, const xtrparser::callback_t& f, const xtrparser::checkpoint_callback_t& on_checkpoint, const size_t offset, const std::string& state) const
+	{
+		const position_callback_t on_position = [&](const char* position, const trace_state_t& t) {
+			std::stringstream s;
+			t.save(s);
+			on_checkpoint(static_cast<size_t>(position - data), s.str());
+		};
+		
+		if(state.empty())
+		{
+			xtrscanner scanner(data, data + size);
+			loadTrace(m, scanner, f, on_position);
+			return;
+		}
+		
+		if(offset > size)
+			throw invalid_format("Checkpoint beyond the end of the trace");
+		
+		trace_state_t t(m, selection);
+		std::stringstream s(state);
+		t.restore(s);
+		
+		xtrscanner scanner(data + offset, data + size);
+		resumeTrace(m, scanner, t, f, on_position);
 	}
 	
 	void xtrparser::parse(const std::string model, const std::string trace, const xtrparser::callback_t& f) const
 	{
-		FILE *file;
 		uppaalmodel_t m;
 		
 		try
 		{
-			file = fopen(model.c_str(), "r");
-			if(file == NULL)
-				exit(1);
-
-			loadIF(m, file);
-			fclose(file);
-
-			file = fopen(trace.c_str(), "r");
-			if(file == NULL)
-				exit(1);
-
-			loadTrace(m, file, f);
-			fclose(file);
+			load(m, model);
+			
+			boost::iostreams::mapped_file_source trace_file(trace);
+			parse(m, trace_file.data(), trace_file.size(), f);
 		}
 		catch(std::exception &e)
 		{
@@ -34,8 +34,17 @@
 #include <cstring>
 #include <cstdlib>
 #include <functional>
+#include <memory>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/optional.hpp>
+#include <boost/utility/string_ref.hpp>
 
 #include "concepts.hpp"
+#include "dbm.hpp"
+#include "filter.hpp"
+#include "thread_pool.hpp"
+#include "xtrscanner.hpp"
 
 /* This xtrparser takes an UPPAAL model in the UPPAAL intermediate
  * format and a UPPAAL XTR trace file and returns this as a usable object.
@@ -53,7 +62,14 @@ namespace uppaal2octopus
 	class xtrparser
 	{
 	public:
-		typedef std::function<void(const location_t loc, const clock_t clock, const startend_e startEnd)> callback_t;
+		typedef std::function<void(const location_t& loc, const clock_t clock, const startend_e startEnd)> callback_t;
+		typedef std::function<void(const clock_t clock, const std::vector<std::string>& names, const std::vector<int>& values)> state_callback_t;
+		
+		// Receives the lower bound of every clock of the model relative to t(0), per state
+		typedef std::function<void(const clock_t clock, const std::vector<std::string>& names, const std::vector<int>& values)> clocks_callback_t;
+		
+		// Receives the offset into the trace between two states and the state of the parser there, to resume from.
+		typedef std::function<void(const size_t offset, const std::string& state)> checkpoint_callback_t;
 	
 	private:
 		enum type_t { CONST, CLOCK, VAR, META, COST, LOCATION, FIXED };
@@ -134,7 +150,13 @@ namespace uppaal2octopus
 			std::vector<int> instructions;
 			std::vector<process_t> processes;
 			std::vector<edge_t> edges;
-			std::map<int,std::string> expressions;
+			std::vector<std::pair<int, boost::string_ref>> expressions; // Sorted by id, which need not be dense
+			
+			/* The text of the model, which the expressions refer to: the
+			 * mapped file, or a copy of a model loaded from memory.
+			 */
+			boost::iostreams::mapped_file_source file;
+			std::string copy;
 
 			/* These are mappings from variable and clock indicies to
 			 * the names of these variables and clocks.
@@ -145,6 +167,9 @@ namespace uppaal2octopus
 			uppaalmodel_t() = default;
 			uppaalmodel_t(uppaalmodel_t&) = delete;
 			uppaalmodel_t operator=(uppaalmodel_t&) = delete;
+			
+			// The expression with this id, empty where there is none
+			boost::string_ref expression(const int id) const;
 		};
 		
 		/* A bound for a clock constraint. A bound consists of a value and a
@@ -164,15 +189,30 @@ namespace uppaal2octopus
 			explicit invalid_format(const std::string& arg);
 		};
 
+		/* A single finite clock constraint i - j < bound (or <= bound).
+		 */
+		struct constraint_t
+		{
+			int i, j;
+			bound_t bound;
+		};
+
 		/* A symbolic state. A symbolic state consists of a location vector, a
 		 * variable vector and a zone describing the possible values of the
 		 * clocks in a symbolic manner.
+		 *
+		 * The zone is stored sparsely: only the finite constraints listed in
+		 * the trace are kept, all other entries of the DBM are infinite. A
+		 * pair listed more than once has the last bound listed.
 		 */
 		class State
 		{
 		public:
 			State();
-			State(const uppaalmodel_t& m, FILE *);
+			State(const uppaalmodel_t& m, xtrscanner&);
+
+			// Advances the scanner past a state without decoding it.
+			static void skip(const uppaalmodel_t& m, xtrscanner&);
 
 			int &getLocation(int i)
 			{
@@ -182,10 +222,6 @@ namespace uppaal2octopus
 			{
 				return integers[i];
 			}
-			bound_t &getConstraint(const uppaalmodel_t& m, int i, int j)
-			{
-				return dbm[i * m.clocks.size() + j];
-			}
 			int getLocation(int i) const
 			{
 				return locations[i];
@@ -194,15 +230,19 @@ namespace uppaal2octopus
 			{
 				return integers[i];
 			}
-			bound_t getConstraint(const uppaalmodel_t& m, int i, int j) const
+			const std::vector<int>& getVariables() const
+			{
+				return integers;
+			}
+			const std::vector<constraint_t>& getConstraints() const
 			{
-				return dbm[i * m.clocks.size() + j];
+				return constraints;
 			}
+			bound_t getConstraint(int i, int j) const;
 		private:
 			std::vector<int> locations;
 			std::vector<int> integers;
-			std::vector<bound_t> dbm;
-			void allocate(const uppaalmodel_t& m);
+			std::vector<constraint_t> constraints;
 		};
 
 		/* A transition consists of one or more edges. Edges are indexes from
@@ -211,7 +251,10 @@ namespace uppaal2octopus
 		class Transition
 		{
 		public:
-			Transition(const uppaalmodel_t& m, FILE *);
+			Transition(const uppaalmodel_t& m, xtrscanner&);
+
+			// Advances the scanner past a transition without decoding it.
+			static void skip(xtrscanner&);
 
 			int getEdge(int32_t process) const
 			{
@@ -227,21 +270,107 @@ namespace uppaal2octopus
 		// The bound (0, <=).
 		static constexpr const bound_t zero = { 0, false };
 		
-		// Reads one line from file. Skips comments.
-		bool read(FILE *file, char *str, size_t n) const;
-
-		// xtrparser for intermediate format.
-		void loadIF(uppaalmodel_t& m, FILE *file) const;
+		/* xtrparser for intermediate format. Every line is split on ':' once
+		 * and layout cells are told apart by a perfect hash of their type.
+		 * The edges and expressions, the bulk of large models, are parsed in
+		 * chunks on the decoding threads.
+		 */
+		void loadIF(uppaalmodel_t& m, const char* data, const size_t size) const;
 		
 		size_t findClock(const uppaalmodel_t& m, const std::string str) const;
 		int getClock(const uppaalmodel_t& m, const State& s) const;
 		
-		// Read and output a trace file.
-		void loadTrace(const uppaalmodel_t& m, FILE *file, const callback_t& f) const;
+		// The lower bounds of all clocks of a state into result, without a search per clock, using
+		// d for m.clocks as scratch space.
+		void getClocks(const uppaalmodel_t& m, const State& s, dbm& d, std::vector<int>& result) const;
+		
+		/* The sequential part of reading a trace: the clock at which each
+		 * process entered its current location, and the target of the last
+		 * edge it took.
+		 */
+		struct trace_state_t
+		{
+			uint32_t clock;
+			std::vector<uint32_t> startClocks;
+			std::vector<boost::optional<int>> targets;
+			
+			// The filter resolved for this model, per process and per location cell.
+			std::vector<bool> processes, locations;
+			
+			trace_state_t(const uppaalmodel_t& m, const filter& selection);
+			
+			void save(std::ostream& os) const;
+			void restore(std::istream& is);
+		};
+		
+		typedef std::function<void(const char* position, const trace_state_t& t)> position_callback_t;
+		
+		// Threads decoding states, or none to decode sequentially.
+		std::shared_ptr<thread_pool> pool;
+		
+		filter selection;
+		
+		// Receives the variable values of every state, if set
+		state_callback_t on_state;
+		
+		// Receives the clock bounds of every state, if set
+		clocks_callback_t on_clocks;
+		
+		// Read and output a trace file, optionally passing the position between states every so often.
+		void loadTrace(const uppaalmodel_t& m, xtrscanner& scanner, const callback_t& f, const position_callback_t& on_position) const;
+		void resumeTrace(const uppaalmodel_t& m, xtrscanner& scanner, trace_state_t& t, const callback_t& f, const position_callback_t& on_position) const;
+		void loadStates(const uppaalmodel_t& m, xtrscanner& scanner, trace_state_t& t, const callback_t& f, const position_callback_t& on_position) const;
+		void loadStatesParallel(const uppaalmodel_t& m, xtrscanner& scanner, trace_state_t& t, const callback_t& f, const position_callback_t& on_position) const;
+		
+		// Output the locations left by a transition taken at clock.
+		void advance(const uppaalmodel_t& m, trace_state_t& t, const Transition& transition, const uint32_t clock, const callback_t& f) const;
+		
+		// Output the locations the processes are in at the end of the trace.
+		void finish(const uppaalmodel_t& m, const trace_state_t& t, const callback_t& f) const;
 		
 		void workaround(uppaalmodel_t& m, int l) const;
 
 	public:
+		typedef uppaalmodel_t model_t;
+	
+		// Decode states of xtr traces on the given number of threads (0 means all cores).
+		xtrparser(const size_t threads = 1, const filter& selection = filter(), const state_callback_t& on_state = nullptr, const clocks_callback_t& on_clocks = nullptr);
+		
+		// Load a model in intermediate format, which can be reused for any number of traces.
+		void load(model_t& m, const std::string model) const;
+		void load(model_t& m, const char* data, const size_t size) const;
+		
+		// Read a trace from memory. Unlike the file based parse, errors are thrown.
+		void parse(const model_t& m, const char* data, const size_t size, const callback_t& f) const;
+		
+		/* Idem, passing checkpoints to on_checkpoint. Given the state of a
+		 * checkpoint, the trace is continued from its offset instead.
+		 */
+		void parse(const model_t& m, const char* data, const size_t size, const callback_t& f, const checkpoint_callback_t& on_checkpoint, const size_t offset = 0, const std::string& state = "") const;
+		
 		void parse(const std::string model, const std::string trace, const callback_t& f) const;
+		
+		/* Reads a trace from memory one state at a time, for consumers
+		 * pulling events. The parser, model and buffer must outlive it.
+		 */
+		class stepper
+		{
+			enum class phase_e { initial, states, done };
+		
+			const xtrparser& parser;
+			const model_t& m;
+			xtrscanner scanner;
+			trace_state_t t;
+			phase_e phase;
+			
+			dbm clock_bounds;
+			std::vector<int> clocks; // Of the last state
+			
+		public:
+			stepper(const xtrparser& parser, const model_t& m, const char* data, const size_t size);
+			
+			// Parse the next state of the trace; false if the trace has ended.
+			bool next(const callback_t& f);
+		};
 	};
 }
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace uppaal2octopus
+{
+	/* Scanner for the xtr trace grammar, working directly on an in-memory
+	 * buffer. The grammar only consists of (signed) integers, whitespace
+	 * and '.' separators, thus there is no need for the generic (and slow)
+	 * format parsing of fscanf.
+	 *
+	 * The semantics mirror those of the fscanf calls this replaces: reading
+	 * an integer skips leading whitespace and leaves the position untouched
+	 * if no integer follows.
+	 */
+	class xtrscanner
+	{
+		const char* pos;
+		const char* end;
+
+		static bool is_space(const char c)
+		{
+			return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+		}
+
+		static bool is_digit(const char c)
+		{
+			return static_cast<unsigned char>(c - '0') < 10;
+		}
+
+	public:
+		xtrscanner(const char* begin, const char* end)
+		: pos(begin)
+		, end(end)
+		{}
+
+		xtrscanner(const xtrscanner&) = default;
+		xtrscanner& operator=(const xtrscanner&) = default;
+
+		const char* position() const
+		{
+			return pos;
+		}
+
+		// A scanner over the same buffer, starting at p.
+		xtrscanner seek(const char* p) const
+		{
+			return xtrscanner(p, end);
+		}
+
+		bool eof() const
+		{
+			return pos == end;
+		}
+
+		void skip_whitespace()
+		{
+			while(pos != end && is_space(*pos))
+				pos++;
+		}
+
+		// Consumes c if it is the next character, without skipping whitespace.
+		bool try_consume(const char c)
+		{
+			if(pos == end || *pos != c)
+				return false;
+
+			pos++;
+			return true;
+		}
+
+		// Equivalent to fscanf(file, ".\n"), the separator of all xtr blocks.
+		void separator()
+		{
+			skip_whitespace();
+			try_consume('.');
+			skip_whitespace();
+		}
+
+		// Equivalent to fscanf(file, "%d", &x) == 1.
+		bool try_read_int(int& x)
+		{
+			skip_whitespace();
+
+			const char* p = pos;
+			bool negative = false;
+			if(p != end && (*p == '-' || *p == '+'))
+				negative = (*p++ == '-');
+
+			if(p == end || !is_digit(*p))
+				return false;
+
+			uint32_t v = 0;
+			while(p != end && is_digit(*p))
+				v = v * 10 + static_cast<uint32_t>(*p++ - '0');
+
+			x = static_cast<int>(negative ? 0u - v : v);
+			pos = p;
+			return true;
+		}
+	};
+}